@@ -0,0 +1,73 @@
+// HIT RATIO OF THE TERM CACHE UNDER MIXED LONG-TAIL / SHORT-TAIL TRAFFIC
+// Replays the load generator's query mix against a cache used the way SearchService
+// uses the term frequency cache (get, put on a miss) and compares the hit ratio with
+// and without TinyLFU admission.
+// Usage: ./cache_admission_bench [capacity] [long_tail_percent] [lookups]
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "utils/lru_cache.h"
+
+using namespace std;
+
+// popular words drawn Zipf-like (a few dominate), like short-tail queries
+static const size_t POPULAR_WORDS = 500;
+// random word_N terms, every one about equally rare, like long-tail queries
+static const size_t RANDOM_WORDS = 10000;
+
+// replays the trace, returns the hit ratio
+static double run(LRUCache<string, string> &cache, const vector<string> &trace, double &seconds)
+{
+    auto start = chrono::steady_clock::now();
+    for (const auto &word : trace)
+    {
+        if (!cache.get(word))
+            cache.put(word, string(64, 'x'));
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    seconds = elapsed.count();
+    return static_cast<double>(cache.hits()) / (cache.hits() + cache.misses());
+}
+
+int main(int argc, char *argv[])
+{
+    int capacity = argc > 1 ? atoi(argv[1]) : 1000;
+    int long_tail_percent = argc > 2 ? atoi(argv[2]) : 50;
+    size_t lookups = argc > 3 ? strtoul(argv[3], nullptr, 10) : 2000000;
+
+    vector<double> weights;
+    for (size_t i = 0; i < POPULAR_WORDS; i++)
+        weights.push_back(1.0 / (i + 1));
+    discrete_distribution<size_t> popular(weights.begin(), weights.end());
+    uniform_int_distribution<size_t> random_word(0, RANDOM_WORDS - 1);
+    uniform_int_distribution<int> percent(0, 99);
+
+    mt19937 rng(42);
+    vector<string> trace;
+    trace.reserve(lookups);
+    for (size_t i = 0; i < lookups; i++)
+    {
+        if (percent(rng) < long_tail_percent)
+            trace.push_back("word_" + to_string(random_word(rng)));
+        else
+            trace.push_back("popular_" + to_string(popular(rng)));
+    }
+
+    cout << "capacity " << capacity << ", " << long_tail_percent << "% long-tail, " << lookups << " lookups" << endl;
+
+    double seconds;
+    LRUCache<string, string> clock_cache(capacity, 16);
+    double clock_ratio = run(clock_cache, trace, seconds);
+    cout << "clock:    hit ratio " << clock_ratio << ", " << seconds * 1e9 / lookups << " ns/lookup" << endl;
+
+    LRUCache<string, string> tiny_lfu_cache(capacity, 16, 0, nullptr, AdmissionPolicy::TINY_LFU);
+    double tiny_lfu_ratio = run(tiny_lfu_cache, trace, seconds);
+    cout << "tinylfu:  hit ratio " << tiny_lfu_ratio << ", " << seconds * 1e9 / lookups << " ns/lookup" << endl;
+
+    return 0;
+}
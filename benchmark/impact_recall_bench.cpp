@@ -0,0 +1,116 @@
+// BENCHMARK FOR THE IMPACT-QUANTIZED INDEX
+// Builds a synthetic Zipf corpus, then compares the exact top-k (exhaustive tf-idf)
+// with the top-k picked from 8 and 16 bit impacts: recall@k and time per query.
+// Usage: ./impact_recall_bench [num_docs] [num_queries] [top_k]
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "index/impact_index.h"
+#include "index/inverted_index.h"
+#include "index/top_k_evaluator.h"
+#include "models/idf_table.h"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    size_t num_docs = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+    size_t num_queries = argc > 2 ? strtoul(argv[2], nullptr, 10) : 1000;
+    size_t top_k = argc > 3 ? strtoul(argv[3], nullptr, 10) : 10;
+    const size_t vocabulary = 50000;
+
+    // word ranks follow a Zipf distribution, documents are 20-300 words long
+    mt19937 rng(7);
+    vector<double> weights(vocabulary);
+    for (size_t w = 0; w < vocabulary; w++)
+        weights[w] = 1.0 / (w + 1);
+    discrete_distribution<size_t> zipf(weights.begin(), weights.end());
+    uniform_int_distribution<int> length(20, 300);
+
+    vector<TermFrequency> records;
+    unordered_map<size_t, int> document_counts;
+    for (size_t d = 0; d < num_docs; d++)
+    {
+        int total = length(rng);
+        unordered_map<size_t, int> counts;
+        for (int i = 0; i < total; i++)
+            counts[zipf(rng)]++;
+        for (const auto &[word, count] : counts)
+        {
+            records.push_back({"doc-" + to_string(d), "w" + to_string(word), static_cast<float>(count) / total});
+            document_counts[word]++;
+        }
+    }
+
+    InvertedIndex index;
+    index.load(records);
+    unordered_map<string, double> idfs;
+    for (const auto &[word, count] : document_counts)
+        idfs["w" + to_string(word)] = log(static_cast<double>(num_docs) / (count + 1));
+    IDFTable idf_table;
+    idf_table.publish(move(idfs));
+
+    // queries of 1-4 distinct words, skewed towards frequent ones like real traffic
+    vector<vector<string>> queries;
+    uniform_int_distribution<int> query_length(1, 4);
+    for (size_t q = 0; q < num_queries; q++)
+    {
+        unordered_set<string> words;
+        int n = query_length(rng);
+        while (static_cast<int>(words.size()) < n)
+            words.insert("w" + to_string(zipf(rng) % 5000));
+        queries.emplace_back(words.begin(), words.end());
+    }
+
+    // exact answers
+    vector<vector<ScoredDoc>> exact;
+    auto start = chrono::steady_clock::now();
+    for (const auto &words : queries)
+    {
+        index.with_postings(words, [&](const vector<const PostingList *> &lists) {
+            vector<QueryTerm> terms;
+            for (size_t i = 0; i < lists.size(); i++)
+            {
+                if (lists[i])
+                    terms.push_back({lists[i], idf_table.get_idf(words[i])});
+            }
+            exact.push_back(TopKEvaluator::exhaustive(terms, top_k));
+        });
+    }
+    chrono::duration<double> exact_time = chrono::steady_clock::now() - start;
+    cout << "exhaustive: " << exact_time.count() * 1e6 / num_queries << " us/query" << endl;
+
+    for (unsigned bits : {8u, 16u})
+    {
+        ImpactIndex impacts(bits);
+        impacts.rebuild(index, idf_table);
+
+        size_t hits = 0, expected = 0;
+        start = chrono::steady_clock::now();
+        vector<vector<ScoredDoc>> approximate;
+        for (const auto &words : queries)
+            approximate.push_back(impacts.top_k(words, top_k));
+        chrono::duration<double> impact_time = chrono::steady_clock::now() - start;
+
+        for (size_t q = 0; q < queries.size(); q++)
+        {
+            unordered_set<uint32_t> wanted;
+            for (const auto &d : exact[q])
+                wanted.insert(d.doc);
+            for (const auto &d : approximate[q])
+                hits += wanted.count(d.doc);
+            expected += exact[q].size();
+        }
+
+        cout << bits << " bit impacts: " << impact_time.count() * 1e6 / num_queries << " us/query, recall@" << top_k
+             << " " << (expected ? static_cast<double>(hits) / expected : 1.0) << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,140 @@
+// DOCUMENT INGEST THROUGHPUT: PER-WORD INSERT vs COPY vs PIPELINE
+// Writes synthetic documents the way DocumentService::create_document does (one
+// transaction per document: the document row plus its term frequencies) and reports
+// docs/sec for the old one-INSERT-per-word path, the COPY path of
+// TermFrequencyRepository::insert_term_frequencies_bulk and the pipelined path
+// (DB_PIPELINE=true, one round trip per document). Every inserted document is deleted
+// again afterwards. Needs a database created with query.txt.
+// Usage: ./ingest_bench [documents] [words_per_document]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <libpq-fe.h>
+#include <dotenv.h>
+#include "db_connection.h"
+#include "db/document_repository.h"
+#include "db/term_frequency_repository.h"
+#include "utils/tokenizer.h"
+
+using namespace std;
+
+// the previous implementation: one round trip per word
+static bool insert_per_word(DBConnection &db, const vector<TermFrequency> &term_frequencies)
+{
+    for (const auto &tf : term_frequencies)
+    {
+        string frequency = to_string(tf.word_frequency);
+        const char *paramValues[3] = {tf.doc_id.c_str(), tf.word.c_str(), frequency.c_str()};
+        PGresult *res = PQexecParams(db.get_conn(),
+                                     "INSERT INTO term_frequency (doc_id, word, word_frequency) VALUES ($1, $2, $3);",
+                                     3, nullptr, paramValues, nullptr, nullptr, 0);
+        bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+        PQclear(res);
+        if (!ok)
+        {
+            cerr << "Insert failed: " << PQerrorMessage(db.get_conn()) << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// inserts every text in its own transaction, returns docs/sec
+template <typename InsertTermFrequencies>
+static double run(DBConnection &db, const vector<string> &texts, vector<string> &doc_ids, InsertTermFrequencies insert)
+{
+    ConnectionHandle db_handle(&db);
+    DocumentRepository doc_repo(&db_handle);
+
+    auto start = chrono::steady_clock::now();
+    for (const auto &text : texts)
+    {
+        db.begin_transaction();
+        auto doc_id = doc_repo.create_document(text);
+        if (!doc_id || !insert(Tokenizer::tokenize_and_compute(*doc_id, text)))
+        {
+            db.rollback();
+            continue;
+        }
+        db.commit();
+        doc_ids.push_back(*doc_id);
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return texts.size() / elapsed.count();
+}
+
+// inserts every text as one pipeline (implicit transaction), returns docs/sec
+static double run_pipelined(DBConnection &db, const vector<string> &texts, vector<string> &doc_ids)
+{
+    ConnectionHandle db_handle(&db);
+    DocumentRepository doc_repo(&db_handle);
+    TermFrequencyRepository tf_repo(&db_handle);
+
+    auto start = chrono::steady_clock::now();
+    for (const auto &text : texts)
+    {
+        if (!db.begin_pipeline())
+            break;
+        auto doc_id = doc_repo.send_create_document(text);
+        bool sent = doc_id && tf_repo.send_insert_term_frequencies(Tokenizer::tokenize_and_compute(*doc_id, text));
+        if (db.end_pipeline() && sent)
+            doc_ids.push_back(*doc_id);
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return texts.size() / elapsed.count();
+}
+
+int main(int argc, char *argv[])
+{
+    size_t documents = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000;
+    size_t words_per_document = argc > 2 ? strtoul(argv[2], nullptr, 10) : 200;
+
+    dotenv::init("../.env");
+    DBConnection db(dotenv::getenv("DATABASE_NAME"), dotenv::getenv("USERNAME"), dotenv::getenv("PASSWORD"));
+    if (!db.is_connected())
+        return 1;
+
+    // vocabulary drawn Zipf-like so documents share common words and have rare ones
+    const size_t vocabulary = 50000;
+    vector<double> weights;
+    for (size_t i = 0; i < vocabulary; i++)
+        weights.push_back(1.0 / (i + 1));
+    discrete_distribution<size_t> word(weights.begin(), weights.end());
+
+    mt19937 rng(42);
+    vector<string> texts;
+    for (size_t d = 0; d < documents; d++)
+    {
+        string text;
+        for (size_t w = 0; w < words_per_document; w++)
+            text += "word" + to_string(word(rng)) + " ";
+        texts.push_back(text);
+    }
+
+    cout << documents << " documents, " << words_per_document << " words each" << endl;
+
+    vector<string> doc_ids;
+    double per_word = run(db, texts, doc_ids, [&](const vector<TermFrequency> &tfs)
+                          { return insert_per_word(db, tfs); });
+    cout << "per-word INSERT: " << per_word << " docs/sec" << endl;
+
+    ConnectionHandle db_handle(&db);
+    TermFrequencyRepository tf_repo(&db_handle);
+    double copy = run(db, texts, doc_ids, [&](const vector<TermFrequency> &tfs)
+                      { return tf_repo.insert_term_frequencies_bulk(tfs); });
+    cout << "COPY:            " << copy << " docs/sec (" << copy / per_word << "x)" << endl;
+
+    double pipelined = run_pipelined(db, texts, doc_ids);
+    cout << "pipeline:        " << pipelined << " docs/sec (" << pipelined / per_word << "x)" << endl;
+
+    // term frequencies go with their documents (ON DELETE CASCADE)
+    DocumentRepository doc_repo(&db_handle);
+    for (const auto &doc_id : doc_ids)
+        doc_repo.delete_document(doc_id);
+
+    return 0;
+}
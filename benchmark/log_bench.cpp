@@ -0,0 +1,106 @@
+// COST OF A LOG LINE ON THE REQUEST PATH
+// Several threads log the kind of line SearchService writes per cached document, once with
+// cout and endl (what the handlers used to do) and once through the async logger: enabled,
+// disabled at runtime and compiled out. Threads log in bursts small enough for the ring
+// buffers so no line is dropped. Reports CPU time per line on the logging threads and for
+// the whole process (which includes the flusher's writes). Results go to stderr:
+// Usage: ./log_bench [threads] [lines_per_thread] > /dev/null
+
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utils/logger.h"
+
+using namespace std;
+
+static const string DOC_ID = "3f1c2a9e-8d4b-4c7a-9e21-5b6d7f8a9c0d";
+
+// lines a thread logs before pausing for the flusher, well below the ring size
+static const int BURST = 256;
+
+// compiled with debug lines removed, as a server built with LOG_COMPILE_LEVEL=1
+#undef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 1
+static void log_compiled_out(int i)
+{
+    LOG_DEBUG("While searching " << DOC_ID << " found in cache " << i);
+}
+#undef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 0
+
+static void log_cout(int i)
+{
+    cout << "While searching " << DOC_ID << " found in cache " << i << endl;
+}
+
+static void log_debug(int i)
+{
+    LOG_DEBUG("While searching " << DOC_ID << " found in cache " << i);
+}
+
+static void log_info(int i)
+{
+    LOG_INFO("While searching " << DOC_ID << " found in cache " << i);
+}
+
+static long cpu_ns(clockid_t clock)
+{
+    timespec t;
+    clock_gettime(clock, &t);
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+// prints ns of CPU per line on the logging threads and in total
+static void run(const char *name, void (*log)(int), int threads, int lines)
+{
+    atomic<long> thread_ns{0};
+    long process_start = cpu_ns(CLOCK_PROCESS_CPUTIME_ID);
+
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([log, lines, &thread_ns]
+                             {
+                                 long spent = 0;
+                                 for (int i = 0; i < lines; i += BURST)
+                                 {
+                                     long start = cpu_ns(CLOCK_THREAD_CPUTIME_ID);
+                                     for (int j = i; j < i + BURST && j < lines; j++)
+                                         log(j);
+                                     spent += cpu_ns(CLOCK_THREAD_CPUTIME_ID) - start;
+                                     usleep(25000);
+                                 }
+                                 thread_ns += spent;
+                             });
+    }
+    for (auto &worker : workers)
+        worker.join();
+    Logger::instance().flush();
+
+    double total = static_cast<double>(threads) * lines;
+    cerr << "  " << name << thread_ns / total << " ns on the logging thread, "
+         << (cpu_ns(CLOCK_PROCESS_CPUTIME_ID) - process_start) / total << " ns in total" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 8;
+    int lines = argc > 2 ? atoi(argv[2]) : 5000;
+
+    cerr << threads << " threads, " << lines << " lines each, CPU time per line" << endl;
+
+    Logger::set_level(LogLevel::Info);
+    run("cout + endl:            ", log_cout, threads, lines);
+    run("LOG_DEBUG compiled out: ", log_compiled_out, threads, lines);
+    run("LOG_DEBUG disabled:     ", log_debug, threads, lines);
+
+    uint64_t dropped = Logger::instance().dropped();
+    run("LOG_INFO async:         ", log_info, threads, lines);
+    cerr << "  (" << Logger::instance().dropped() - dropped << " async lines dropped)" << endl;
+    return 0;
+}
@@ -0,0 +1,83 @@
+// MICROBENCHMARK FOR THE TERM-AT-A-TIME SCORE KERNEL
+// Scores random posting lists with the scalar and the AVX2 accumulate kernel and
+// reports the time per posting. Usage: ./score_kernel_bench [num_docs] [num_terms] [rounds]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "index/posting_list.h"
+#include "index/score_accumulator.h"
+
+using namespace std;
+
+// scores every list into acc with the given kernel, returns seconds per round
+static double run(ScoreAccumulator &acc, const vector<PostingList> &lists, const vector<double> &idfs,
+                  size_t num_docs, int rounds, ScoreKernel kernel)
+{
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        acc.begin(num_docs);
+        for (size_t t = 0; t < lists.size(); t++)
+        {
+            lists[t].for_each_block([&](const uint32_t *docs, const float *word_frequencies, size_t n)
+                                    { acc.add_block(docs, word_frequencies, n, idfs[t], kernel); });
+        }
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / rounds;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t num_docs = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    size_t num_terms = argc > 2 ? strtoul(argv[2], nullptr, 10) : 4;
+    int rounds = argc > 3 ? atoi(argv[3]) : 50;
+
+    // every term occurs in a random quarter to half of the documents
+    mt19937 rng(42);
+    vector<PostingList> lists;
+    vector<double> idfs;
+    size_t total_postings = 0;
+    for (size_t t = 0; t < num_terms; t++)
+    {
+        uniform_int_distribution<int> density(25, 50);
+        uniform_real_distribution<float> frequency(0.001f, 0.2f);
+        int percent = density(rng);
+        vector<Posting> postings;
+        for (uint32_t doc = 0; doc < num_docs; doc++)
+        {
+            if (static_cast<int>(rng() % 100) < percent)
+                postings.push_back({doc, frequency(rng)});
+        }
+        total_postings += postings.size();
+        lists.emplace_back(move(postings));
+        idfs.push_back(0.5 + t);
+    }
+
+    ScoreAccumulator scalar_acc, simd_acc;
+    // warm up, sizes the accumulators and faults their pages in
+    run(scalar_acc, lists, idfs, num_docs, 1, ScoreKernel::SCALAR);
+    run(simd_acc, lists, idfs, num_docs, 1, ScoreKernel::AVX2);
+
+    double scalar = run(scalar_acc, lists, idfs, num_docs, rounds, ScoreKernel::SCALAR);
+    double simd = run(simd_acc, lists, idfs, num_docs, rounds, ScoreKernel::AVX2);
+
+    // both kernels have to produce the very same scores
+    bool same = scalar_acc.touched == simd_acc.touched;
+    for (size_t i = 0; same && i < scalar_acc.touched.size(); i++)
+    {
+        uint32_t doc = scalar_acc.touched[i];
+        same = scalar_acc.scores[doc] == simd_acc.scores[doc];
+    }
+
+    cout << "postings per round: " << total_postings << endl;
+    cout << "AVX2 available: " << (ScoreAccumulator::best_kernel() == ScoreKernel::AVX2 ? "yes" : "no") << endl;
+    cout << "scalar: " << scalar * 1e9 / total_postings << " ns/posting" << endl;
+    cout << "avx2:   " << simd * 1e9 / total_postings << " ns/posting" << endl;
+    cout << "speedup: " << scalar / simd << "x" << endl;
+    cout << "scores identical: " << (same ? "yes" : "NO") << endl;
+    return same ? 0 : 1;
+}
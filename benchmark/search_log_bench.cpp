@@ -0,0 +1,148 @@
+// GET /search WITH REQUEST LOGGING
+// Runs the short-tail query workload of load_generator (one popular word per query) through
+// SearchService from several threads and writes the same per-request log lines as
+// SearchController::handleGet, including the whole response. Postings come from the
+// in-memory index and texts from the document cache, so no database or HTTP layer is
+// involved and the time measured is the request path and its logging. Log output goes to
+// stdout like the server's, results to stderr:
+// Usage: ./search_log_bench [threads] [seconds] [info|debug] > server.log
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "db/connection_handle.h"
+#include "db/connection_pool.h"
+#include "db/document_repository.h"
+#include "db/term_frequency_repository.h"
+#include "index/inverted_index.h"
+#include "models/idf_table.h"
+#include "service/search_service.h"
+#include "utils/cache_manager.h"
+#include "utils/logger.h"
+#include "utils/tokenizer.h"
+
+using namespace std;
+using namespace std::chrono;
+
+static const vector<string> POPULAR_WORDS = {
+    "apple", "amazon", "google", "microsoft", "tcs", "reliance", "iitb", "facebook", "meta", "tesla",
+    "nvidia", "intel", "oracle", "ibm", "flipkart", "uber", "airbnb", "zoom", "slack", "spotify",
+    "twitter", "linkedin", "github", "docker", "kubernetes", "tensorflow", "pytorch", "opencv", "nlp",
+    "chatgpt", "transformer", "attention", "overfitting", "dropout", "epoch", "batchnorm"};
+
+static const int DOCUMENTS = 20000;
+static const int WORDS_PER_DOCUMENT = 40;
+
+// what SearchController::handleGet does around the search, json dump written out by hand
+static void handle_search(ConnectionPool *pool, IDFTable *idf_table, InvertedIndex *index, const string &query)
+{
+    LOG_DEBUG("Received query: " << query);
+
+    ConnectionHandle db_handle(pool);
+    DocumentRepository doc_repo(&db_handle);
+    TermFrequencyRepository tf_repo(&db_handle);
+    SearchService search_service(&doc_repo, &tf_repo, idf_table, index);
+
+    auto start = high_resolution_clock::now();
+    auto results = search_service.search(query);
+    auto duration = duration_cast<milliseconds>(high_resolution_clock::now() - start);
+
+    LOG_DEBUG("Execution time: " << duration.count());
+
+    string response = "{\"message\":\"Documents retrieved successfully\",\"results\":[";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        if (i > 0)
+            response += ',';
+        response += "{\"doc_id\":\"" + results[i].doc_id + "\",\"score\":" + to_string(results[i].score) +
+                    ",\"text\":\"" + results[i].text + "\"}";
+    }
+    response += "]}";
+    LOG_DEBUG("Documents retrieved successfully");
+    LOG_DEBUG(response);
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 8;
+    int seconds = argc > 2 ? atoi(argv[2]) : 5;
+    string level = argc > 3 ? argv[3] : "info";
+
+    setenv("TERM_FREQUENCY_CACHE_SIZE", "1000", 1);
+    // room to spare so no shard evicts a text
+    setenv("DOCUMENT_CACHE_SIZE", to_string(2 * DOCUMENTS).c_str(), 1);
+    setenv("QUERY_RESULT_CACHE_SIZE", "1000", 1);
+    Logger::set_level(Logger::parse_level(level, LogLevel::Info));
+
+    // corpus in the shape of load_generator's: a few popular words among filler words
+    mt19937 rng(42);
+    InvertedIndex index;
+    unordered_map<string, int> document_counts;
+    auto &doc_cache = CacheManager::documentCache();
+    for (int d = 0; d < DOCUMENTS; d++)
+    {
+        char doc_id[37];
+        snprintf(doc_id, sizeof(doc_id), "%08x-0000-4000-8000-%012x", d, d * 7919);
+        string text;
+        for (int w = 0; w < WORDS_PER_DOCUMENT; w++)
+        {
+            if (w < 3)
+                text += POPULAR_WORDS[rng() % POPULAR_WORDS.size()];
+            else
+                text += "gibberish" + to_string(rng() % 5000);
+            text += ' ';
+        }
+
+        auto term_freqs = Tokenizer::tokenize_and_compute(doc_id, text);
+        for (const auto &tf : term_freqs)
+            document_counts[tf.word]++;
+        index.add_document(doc_id, term_freqs);
+        doc_cache.put(doc_id, text);
+    }
+
+    IDFTable idf_table;
+    unordered_map<string, double> idfs;
+    for (const auto &[word, count] : document_counts)
+        idfs[word] = log(static_cast<double>(DOCUMENTS) / (count + 1));
+    idf_table.publish(move(idfs));
+
+    // never reached: every posting and text is in memory
+    ConnectionPool pool(0, 1, "unused", "unused", "unused", 100, 60000, 60000);
+
+    atomic<long> requests{0};
+    atomic<long> latency_ns{0};
+    auto deadline = steady_clock::now() + std::chrono::seconds(seconds);
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++)
+    {
+        workers.emplace_back([&, t]
+                             {
+                                 mt19937 local(t);
+                                 long count = 0, spent = 0;
+                                 while (steady_clock::now() < deadline)
+                                 {
+                                     auto start = steady_clock::now();
+                                     handle_search(&pool, &idf_table, &index, POPULAR_WORDS[local() % POPULAR_WORDS.size()]);
+                                     spent += duration_cast<nanoseconds>(steady_clock::now() - start).count();
+                                     count++;
+                                 }
+                                 requests += count;
+                                 latency_ns += spent;
+                             });
+    }
+    for (auto &worker : workers)
+        worker.join();
+    Logger::instance().flush();
+
+    cerr << threads << " threads, LOG_LEVEL=" << level << ": " << requests / static_cast<double>(seconds)
+         << " requests/s, average latency " << latency_ns / 1000.0 / requests << " us, "
+         << Logger::instance().dropped() << " log lines dropped" << endl;
+    return 0;
+}
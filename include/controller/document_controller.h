@@ -1,6 +1,9 @@
 #pragma once
 #include "../service/document_service.h"
 #include "../db/connection_pool.h"
+#include "../db/async_executor.h"
+#include "../index/inverted_index.h"
+#include "../service/ingest_queue.h"
 #include "CivetServer.h"
 #include <string>
 #include <memory>
@@ -9,10 +12,14 @@
 class DocumentController : public CivetHandler {
 private:
     ConnectionPool *db_pool; // to maintain same connection object
+    InvertedIndex *index;    // in-memory index to keep in sync, may be null
+    IngestQueue *ingest;     // group commit for creates, null creates each document on its own
+    AsyncExecutor *async_db; // runs GET reads without a pooled connection, may be null
 
 public:
     // Constructor that takes the DB connection pointer
-    explicit DocumentController(ConnectionPool *dp_pool);
+    explicit DocumentController(ConnectionPool *dp_pool, InvertedIndex *index = nullptr, IngestQueue *ingest = nullptr,
+                                AsyncExecutor *async_db = nullptr);
 
     // Handle POST requests for creating a document, done via overriding default method
     bool handlePost(CivetServer* server, struct mg_connection* conn) override;
@@ -1,15 +1,22 @@
 #pragma once
 #include "CivetServer.h"
 #include "../db/connection_pool.h"
+#include "../db/async_executor.h"
 #include "../service/search_service.h"
 #include "../models/idf_table.h"
+#include "../index/inverted_index.h"
+#include "../index/impact_index.h"
 
 class SearchController : public CivetHandler {
 private:
     ConnectionPool *db_pool; // to maintain same connection object
     IDFTable* idf_table;
+    InvertedIndex* index; // in-memory index, null when searching through cache/db
+    ImpactIndex* impacts; // quantized impact index built from it, may be null
+    AsyncExecutor* async_db; // runs the reads without a pooled connection, may be null
 public:
-    SearchController(ConnectionPool *db_pool, IDFTable *idf_table);
+    SearchController(ConnectionPool *db_pool, IDFTable *idf_table, InvertedIndex *index = nullptr, ImpactIndex *impacts = nullptr,
+                     AsyncExecutor *async_db = nullptr);
 
     bool handleGet(CivetServer *server, struct mg_connection *conn) override;
 };
@@ -0,0 +1,92 @@
+#pragma once
+#include <libpq-fe.h>
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../db_connection.h"
+
+// Runs single statements without tying a thread or a pooled connection to each of them.
+// Every I/O thread owns a few connections in non-blocking pipeline mode and waits on all
+// their sockets with epoll: a query is sent as soon as it is submitted, even while earlier
+// ones on the same connection are still running, and its callback fires when its result
+// has been read. Each query is followed by its own sync, so it commits on its own and a
+// failing query does not abort the ones behind it. Not for statements that belong to a
+// transaction, those run on a pinned connection (see ConnectionHandle).
+class AsyncExecutor
+{
+public:
+    // gets the result, or nullptr when the query failed or could not be sent. The result
+    // is cleared once the callback returns. Runs on an I/O thread, keep it short.
+    using Callback = std::function<void(const PGresult *)>;
+
+    AsyncExecutor(int threads, int connections_per_thread, const std::string &db_name,
+                  const std::string &user, const std::string &password);
+    ~AsyncExecutor();
+    AsyncExecutor(const AsyncExecutor &) = delete;
+    AsyncExecutor &operator=(const AsyncExecutor &) = delete;
+
+    // queues statement with its text parameters on one of the I/O threads
+    void submit(const Statement &statement, std::vector<std::string> params, bool binary_result,
+                Callback on_result);
+
+private:
+    struct Query
+    {
+        const Statement *statement;
+        std::vector<std::string> params;
+        bool binary_result;
+        Callback on_result;
+    };
+
+    struct Connection
+    {
+        DBConnection *db = nullptr; // null while broken, reopened at retry_at
+        int socket = -1;
+        bool writing = false;          // waiting for the socket to take the rest of the output
+        std::deque<Query> in_flight;   // sent, in the order their results come back
+        PGresult *result = nullptr;    // result of in_flight.front() read so far
+        std::chrono::steady_clock::time_point retry_at;
+    };
+
+    struct Worker
+    {
+        pthread_t thread;
+        int epoll_fd = -1;
+        int wake_fd = -1; // eventfd, written by submit
+        pthread_mutex_t lock;
+        std::deque<Query> queue; // submitted, not sent yet (guarded by lock)
+        std::vector<Connection> connections;
+        AsyncExecutor *executor;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<uint64_t> next_worker{0};
+    std::atomic<bool> stopping{false};
+    std::string db_name, user, password;
+
+    static void *io_thread(void *arg);
+    void run(Worker &worker);
+
+    // stops the first running I/O threads, then fails whatever is still queued or in flight
+    void shutdown(size_t running);
+
+    // opens connection i of worker and registers its socket, false if the database is down
+    bool connect(Worker &worker, size_t i);
+    // fails everything in flight on a broken connection and closes it
+    void drop(Worker &worker, Connection &connection);
+
+    // sends query on the connection with the fewest queries in flight
+    void dispatch(Worker &worker, Query &query);
+    // pushes buffered output, watching for writability while some is left
+    void flush(Worker &worker, Connection &connection);
+    // reads whatever results arrived and completes their queries
+    void receive(Worker &worker, Connection &connection);
+
+    static void complete(Query &query, const PGresult *res);
+};
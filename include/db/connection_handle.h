@@ -0,0 +1,126 @@
+#pragma once
+#include "connection_pool.h"
+#include "async_executor.h"
+#include "../db_connection.h"
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// What repositories and services talk to instead of a DBConnection. A pooled handle takes
+// a connection from the pool only when a query actually runs and gives it back right
+// after, so requests answered from the caches never touch the pool. A transaction or
+// pipeline pins the connection until it ends, every statement inside runs on it.
+// With an AsyncExecutor, query() sends reads outside a transaction through it instead and
+// no pooled connection is taken at all.
+// A handle is used by one request (thread) at a time.
+class ConnectionHandle
+{
+private:
+    ConnectionPool *pool = nullptr; // null for a handle wrapping a fixed connection
+    AsyncExecutor *executor = nullptr;
+    DBConnection *conn = nullptr;
+    int leases = 0;      // Lease objects currently using conn
+    bool pinned = false; // inside a transaction or pipeline
+    bool failed_acquire = false;
+
+    DBConnection *lease();
+    void unlease();
+
+    // gives the connection back when nothing uses it any more
+    void release_if_unused();
+
+public:
+    // lazily acquires from pool, query() goes through executor when one is given
+    explicit ConnectionHandle(ConnectionPool *pool, AsyncExecutor *executor = nullptr);
+    // always uses conn, which stays owned by the caller
+    explicit ConnectionHandle(DBConnection *conn);
+    ~ConnectionHandle();
+    ConnectionHandle(const ConnectionHandle &) = delete;
+    ConnectionHandle &operator=(const ConnectionHandle &) = delete;
+
+    // true once a query could not get a connection (pool exhausted), the request should
+    // report the database as unavailable rather than an empty result
+    bool unavailable() const { return failed_acquire; }
+
+    // true when query() returns before its result is in (it goes through the executor),
+    // so several reads of a request can be in flight at once
+    bool overlaps_reads() const { return executor && !conn; }
+
+    // A connection for the duration of one repository call, acquired if none is held.
+    // Converts to false when none could be had (or it is broken).
+    class Lease
+    {
+        ConnectionHandle *handle;
+        DBConnection *conn;
+
+    public:
+        explicit Lease(ConnectionHandle *handle) : handle(handle), conn(handle ? handle->lease() : nullptr) {}
+        ~Lease()
+        {
+            if (handle && conn)
+                handle->unlease();
+        }
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+
+        explicit operator bool() const { return conn && conn->is_connected(); }
+        DBConnection *operator->() const { return conn; }
+    };
+
+    // transactions pin the connection from begin until commit / rollback
+    bool begin_transaction();
+    bool commit();
+    bool rollback();
+
+    // pipelines pin it from begin_pipeline until end_pipeline
+    bool begin_pipeline();
+    bool end_pipeline();
+
+    // Runs statement and turns its result into a T with read, which gets nullptr when the
+    // query failed. Goes through the executor unless there is none or a connection is
+    // held (transaction, pipeline); otherwise it runs right here on a leased connection
+    // and the future is ready on return.
+    template <typename T>
+    std::future<T> query(const Statement &statement, std::vector<std::string> params, bool binary_result,
+                         std::function<T(const PGresult *)> read)
+    {
+        auto promise = std::make_shared<std::promise<T>>();
+        std::future<T> result = promise->get_future();
+
+        auto deliver = [promise, read](const PGresult *res)
+        {
+            try
+            {
+                promise->set_value(read(res));
+            }
+            catch (...)
+            {
+                promise->set_exception(std::current_exception());
+            }
+        };
+
+        if (executor && !conn)
+        {
+            executor->submit(statement, std::move(params), binary_result, deliver);
+            return result;
+        }
+
+        PGresult *res = nullptr;
+        {
+            Lease db(this);
+            if (db)
+            {
+                std::vector<const char *> values;
+                for (const auto &param : params)
+                    values.push_back(param.c_str());
+                res = db->execute_prepared(statement, values.data(), binary_result);
+            }
+        }
+        deliver(res);
+        PQclear(res);
+        return result;
+    }
+};
@@ -1,26 +1,82 @@
 #pragma once
 
 #include <pthread.h>
-#include <queue>
+#include <atomic>
+#include <cstdint>
+#include <deque>
 #include <string>
+#include <time.h>
 #include "../db_connection.h"
 
+// Pool of database connections between min_size and max_size. acquire() waits at most
+// acquire_timeout_ms and returns nullptr when the pool stays exhausted, so callers can
+// shed load instead of piling up. It never connects itself: new connections are opened
+// by a background thread, which the wait does not depend on. Every health_check_ms a background thread pings the
+// connections idle for longer than that, one at a time, reconnects broken ones and closes
+// connections above min_size that sat idle for idle_timeout_ms.
 class ConnectionPool {
 public:
-    ConnectionPool(int poolSize, const std::string &db_name,
+    ConnectionPool(int min_size, int max_size, const std::string &db_name,
                    const std::string &user,
-                   const std::string &password);
+                   const std::string &password,
+                   long acquire_timeout_ms = 5000,
+                   long idle_timeout_ms = 60000,
+                   long health_check_ms = 10000);
     ~ConnectionPool();
 
+    // a healthy connection, or nullptr if none became available within the timeout
     DBConnection* acquire();
     void release(DBConnection* conn);
 
+    // prints open / in use / idle connections, acquires, timeouts and wait times
+    void logStats();
+
 private:
-    std::queue<DBConnection*> pool;
+    struct Idle {
+        DBConnection *conn;
+        timespec since; // CLOCK_MONOTONIC time it was released
+    };
+
+    // most recently released at the back: acquire reuses warm connections and the
+    // ones at the front age out
+    std::deque<Idle> idle;
+    size_t open = 0; // connections that exist, idle or in use (including ones being opened)
 
     pthread_mutex_t lock;
-    pthread_cond_t cond;
+    pthread_cond_t cond;      // signalled when a connection is released or a slot frees up
+    pthread_cond_t health_cond; // wakes the health check thread for shutdown or to grow the pool
 
-    size_t size;
-};
+    size_t min_size;
+    size_t max_size;
+    long acquire_timeout_ms;
+    long idle_timeout_ms;
+    long health_check_ms;
+    std::string db_name, user, password;
+
+    pthread_t health_thread;
+    bool stopping = false;
+    bool grow_requested = false; // an acquire found nothing idle while below max_size
+    size_t waiting = 0;          // acquires waiting for a connection
+
+    std::atomic<uint64_t> acquires{0};
+    std::atomic<uint64_t> timeouts{0};
+    std::atomic<uint64_t> wait_us{0};     // summed over all acquires
+    std::atomic<uint64_t> max_wait_us{0};
+    std::atomic<uint64_t> reconnects{0};
 
+    // opens a new connection, nullptr (logged) if the database is unreachable
+    DBConnection *connect();
+
+    // true if conn is usable, reconnecting it if it broke
+    bool heal(DBConnection *conn);
+
+    // closes a connection the pool gives up on, needs lock
+    void discard(DBConnection *conn);
+
+    static void *health_check_thread(void *arg);
+    void check_idle();
+
+    // opens connections while acquires are waiting and the pool is below max_size. Runs on
+    // the health check thread, so a slow connect never holds up an acquire past its timeout
+    void grow();
+};
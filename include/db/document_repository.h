@@ -1,5 +1,6 @@
 #pragma once
-#include "./db_connection.h"
+#include "connection_handle.h"
+#include <future>
 #include <string>
 #include <vector>
 #include <optional>
@@ -7,18 +8,38 @@
 
 class DocumentRepository {
 private:
-    DBConnection* db;  // pointer to DB connection
+    ConnectionHandle* handle; // leases a connection for each call
 
 public:
     // Constructor
-    DocumentRepository(DBConnection* db_conn);
+    DocumentRepository(ConnectionHandle* db_handle);
 
     // Create a new document and return the generated doc_id
     std::optional<std::string> create_document(const std::string &text);
 
+    // Create several documents with one COPY, returns their doc_ids in the order of texts
+    std::optional<std::vector<std::string>> create_documents_bulk(const std::vector<std::string> &texts);
+
+    // Queue the insert of a new document on a connection in pipeline mode, returns the
+    // doc_id it will get. Success is only known once the pipeline ends.
+    std::optional<std::string> send_create_document(const std::string &text);
+
     // Read a document by doc_id
     std::optional<Document> get_document_by_id(const std::string &doc_id);
 
+    // same read, answered through the handle's async executor when it has one
+    std::future<std::optional<Document>> fetch_document_by_id(const std::string &doc_id);
+
+    // Read several documents with one query, ids that do not exist are left out
+    std::vector<Document> get_documents_by_ids(const std::vector<std::string> &doc_ids);
+
+    // same read, answered through the handle's async executor when it has one
+    std::future<std::vector<Document>> fetch_documents_by_ids(const std::vector<std::string> &doc_ids);
+
+    // true when fetches are answered by the async executor, a fetch then runs alongside
+    // whatever the caller does before waiting on it
+    bool overlaps_reads() const { return handle->overlaps_reads(); }
+
     // Read all documents
     std::vector<Document> get_all_documents();
     
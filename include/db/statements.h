@@ -0,0 +1,78 @@
+#pragma once
+
+// A statement the repositories run. Every DBConnection prepares all of them once when it
+// connects, so a call only sends the name and the parameters and the server skips parsing
+// and planning. Word lists travel as one text[] parameter ($1::text[]), never spliced into
+// the SQL. COPY and transaction control cannot be prepared and are sent as plain text.
+struct Statement
+{
+    const char *name;
+    const char *sql;
+    int n_params;
+};
+
+namespace Statements
+{
+    // documents
+    inline constexpr Statement INSERT_DOCUMENT{
+        "insert_document", "INSERT INTO documents (document_text) VALUES ($1) RETURNING doc_id;", 1};
+    inline constexpr Statement INSERT_DOCUMENT_WITH_ID{
+        "insert_document_with_id", "INSERT INTO documents (doc_id, document_text) VALUES ($1::uuid, $2);", 2};
+    inline constexpr Statement GET_DOCUMENT{
+        "get_document", "SELECT doc_id, document_text, created_at::text FROM documents WHERE doc_id = $1::uuid;", 1};
+    inline constexpr Statement GET_DOCUMENTS{
+        "get_documents",
+        "SELECT doc_id, document_text, created_at::text FROM documents WHERE doc_id = ANY($1::uuid[]);", 1};
+    inline constexpr Statement GET_ALL_DOCUMENTS{
+        "get_all_documents", "SELECT doc_id, document_text, created_at::text FROM documents;", 0};
+    inline constexpr Statement COUNT_DOCUMENTS{
+        "count_documents", "SELECT COUNT(*) FROM documents;", 0};
+    inline constexpr Statement DELETE_DOCUMENT{
+        "delete_document", "DELETE FROM documents WHERE doc_id = $1::uuid;", 1};
+
+    // term_frequency
+    inline constexpr Statement INSERT_TERM_FREQUENCIES{
+        "insert_term_frequencies",
+        "INSERT INTO term_frequency (doc_id, word, word_frequency) "
+        "SELECT * FROM unnest($1::uuid[], $2::text[], $3::real[]);", 3};
+    inline constexpr Statement GET_TERM_FREQUENCIES_FOR_WORDS{
+        "get_term_frequencies_for_words",
+        "SELECT word, doc_id, word_frequency FROM term_frequency WHERE word = ANY($1::text[]);", 1};
+    inline constexpr Statement GET_ALL_TERM_FREQUENCIES{
+        "get_all_term_frequencies", "SELECT doc_id, word, word_frequency FROM term_frequency;", 0};
+    inline constexpr Statement GET_DOCUMENT_WORDS{
+        "get_document_words", "SELECT word FROM term_frequency WHERE doc_id = $1::uuid ORDER BY word;", 1};
+    inline constexpr Statement COUNT_DOCUMENTS_PER_WORD{
+        "count_documents_per_word",
+        "SELECT word, COUNT(DISTINCT doc_id)::integer AS document_count FROM term_frequency GROUP BY word;", 0};
+
+    // word_df. A word listed n times (once per new document) counts n documents. Rows are
+    // locked in word order, so concurrent writers cannot deadlock on them
+    inline constexpr Statement INCREMENT_DOCUMENT_FREQUENCIES{
+        "increment_document_frequencies",
+        "INSERT INTO word_df (word, document_count) "
+        "SELECT word, count(*) FROM unnest($1::text[]) AS word GROUP BY word ORDER BY word "
+        "ON CONFLICT (word) DO UPDATE SET document_count = word_df.document_count + EXCLUDED.document_count;", 1};
+    inline constexpr Statement DECREMENT_DOCUMENT_FREQUENCIES{
+        "decrement_document_frequencies",
+        "UPDATE word_df SET document_count = document_count - 1 "
+        "WHERE word IN (SELECT word FROM word_df WHERE word = ANY($1::text[]) ORDER BY word FOR UPDATE);", 1};
+    inline constexpr Statement DELETE_UNUSED_DOCUMENT_FREQUENCIES{
+        "delete_unused_document_frequencies",
+        "DELETE FROM word_df WHERE word = ANY($1::text[]) AND document_count <= 0;", 1};
+    inline constexpr Statement GET_DOCUMENT_FREQUENCIES{
+        "get_document_frequencies", "SELECT word, document_count FROM word_df;", 0};
+    inline constexpr Statement BACKFILL_DOCUMENT_FREQUENCIES{
+        "backfill_document_frequencies",
+        "INSERT INTO word_df (word, document_count) "
+        "SELECT word, COUNT(*) FROM term_frequency GROUP BY word "
+        "ON CONFLICT (word) DO NOTHING;", 0};
+
+    // prepared by every connection
+    inline constexpr const Statement *ALL[] = {
+        &INSERT_DOCUMENT, &INSERT_DOCUMENT_WITH_ID, &GET_DOCUMENT, &GET_DOCUMENTS, &GET_ALL_DOCUMENTS,
+        &COUNT_DOCUMENTS, &DELETE_DOCUMENT, &INSERT_TERM_FREQUENCIES, &GET_TERM_FREQUENCIES_FOR_WORDS, &GET_ALL_TERM_FREQUENCIES,
+        &GET_DOCUMENT_WORDS, &COUNT_DOCUMENTS_PER_WORD, &INCREMENT_DOCUMENT_FREQUENCIES,
+        &DECREMENT_DOCUMENT_FREQUENCIES, &DELETE_UNUSED_DOCUMENT_FREQUENCIES, &GET_DOCUMENT_FREQUENCIES,
+        &BACKFILL_DOCUMENT_FREQUENCIES};
+}
@@ -1,24 +1,56 @@
 #pragma once
+#include <future>
 #include <string>
 #include <vector>
-#include "db_connection.h"
+#include <optional>
+#include "connection_handle.h"
 #include "../models/term_frequency.h" 
 #include "../models/idf_stats.h"     
 
 class TermFrequencyRepository {
 
 private:
-    DBConnection* db;
+    ConnectionHandle* handle; // leases a connection for each call
 
 public:
-    TermFrequencyRepository(DBConnection* db_conn);
+    TermFrequencyRepository(ConnectionHandle* db_handle);
 
-    // Bulk insert/update term frequencies (Always update all words together for a single document simultaneously)
+    // Bulk insert term frequencies of new documents with a single COPY, rows may span several
+    // documents. (doc_id, word) pairs must not exist yet, a duplicate fails the whole batch.
     bool insert_term_frequencies_bulk(const std::vector<TermFrequency>& term_frequencies);
 
-    // Retrieve WordStats for a set of query words (used for TF-IDF scoring)
-    std::vector<TermFrequency> get_word_stats_for_query(const std::vector<std::string>& words);
+    // same insert, queued on a connection in pipeline mode (see DBConnection::begin_pipeline)
+    bool send_insert_term_frequencies(const std::vector<TermFrequency>& term_frequencies);
+
+    // Retrieve WordStats for a set of query words (used for TF-IDF scoring). nullopt when
+    // the lookup failed, unlike an empty vector for words without postings
+    std::optional<std::vector<TermFrequency>> get_word_stats_for_query(const std::vector<std::string>& words);
+
+    // same read, answered through the handle's async executor when it has one
+    std::future<std::optional<std::vector<TermFrequency>>> fetch_word_stats_for_query(const std::vector<std::string>& words);
 
     // fetch idf stats (word,count of docs)
     std::vector<IDFStats> get_all_idf_stats();
+
+    // fetch every row of the term_frequency table (used to build the in-memory index)
+    std::vector<TermFrequency> get_all_term_frequencies();
+
+    // counts one more document in word_df for each occurrence of a word in words, i.e. the
+    // distinct words of each new document concatenated. Call inside the inserting transaction
+    bool increment_document_frequencies(const std::vector<std::string>& words);
+
+    // same update, queued on a connection in pipeline mode
+    bool send_increment_document_frequencies(const std::vector<std::string>& words);
+
+    // counts the document out of word_df for each of its words, dropping words that no
+    // longer occur, and returns its words. Call inside the transaction deleting it, before
+    // the delete cascades to term_frequency. nullopt on failure.
+    std::optional<std::vector<std::string>> decrement_document_frequencies(const std::string& doc_id);
+
+    // fetch every row of word_df (word, number of documents containing it)
+    std::vector<IDFStats> get_document_frequencies();
+
+    // fills an empty word_df from term_frequency (one GROUP BY, for databases created
+    // before word_df existed)
+    bool backfill_document_frequencies();
 };
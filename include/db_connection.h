@@ -2,13 +2,20 @@
 #pragma once
 
 #include <libpq-fe.h>
+#include <cstdint>
 #include <string>
+#include "db/statements.h"
 
 class DBConnection
 {
 private:
     PGconn *conn;
     std::string connection_str;
+    int pipeline_pending = 0;     // queries sent in the current pipeline whose results are unread
+    bool pipeline_failed = false; // a query of the current pipeline could not be sent
+
+    // prepares every statement of db/statements.h on the new connection
+    bool prepare_statements();
 
 public:
     DBConnection(const std::string &db_name,
@@ -25,11 +32,43 @@ public:
     // Executes a query and returns the raw PGresult pointer. Note: to call PQclear(res) once done.
     PGresult* execute_query(const std::string &query);
 
+    // Runs a prepared statement (see db/statements.h) with text parameters. binary_result
+    // asks for every column in binary format, read those with the *_value accessors below.
+    // Returns nullptr on failure. Note: to call PQclear(res) once done.
+    PGresult* execute_prepared(const Statement &statement, const char *const *param_values,
+                               bool binary_result = false);
+
+    // accessors for binary result columns: uuid as its text form, real, integer of any width
+    static std::string text_value(const PGresult *res, int row, int column);
+    static std::string uuid_value(const PGresult *res, int row, int column);
+    static float real_value(const PGresult *res, int row, int column);
+    static int64_t int_value(const PGresult *res, int row, int column);
+
+    // Streams rows into a table with COPY ... FROM STDIN. copy_statement is the COPY
+    // command, data the rows in COPY text format. One round trip for any number of rows.
+    bool copy_in(const std::string &copy_statement, const std::string &data);
+
+    // appends value as one COPY text format field, escaping the characters COPY treats specially
+    static void append_copy_field(std::string &row, const std::string &value);
+
+    // Pipeline mode: between begin_pipeline and end_pipeline queries are only sent with
+    // send_query, and end_pipeline syncs and reads all their results. Statements up to the
+    // sync run as one implicit transaction, an error rolls all of them back.
+    bool begin_pipeline();
+    bool send_query(const Statement &statement, const char *const *param_values);
+    bool end_pipeline(); // true if every query of the pipeline succeeded
+
     // adding a getter to obtain connection
     PGconn* get_conn() const; 
 
     void test_connection(); // dummy method to test connection
 
+    // round trip to check the connection still works
+    bool ping();
+
+    // reopens a broken connection and prepares the statements again
+    bool reconnect();
+
     // methods to manipulate transactions
     bool begin_transaction();
     bool commit();
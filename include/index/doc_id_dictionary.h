@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+#include <pthread.h>
+
+// Process wide mapping between document UUIDs and dense uint32 ordinals.
+// Postings, caches and score accumulators work on ordinals, the UUID string is
+// only looked up again for the final top-k. Ordinals are handed out in increasing
+// order and never reused, so a deleted document simply leaves a hole.
+class DocIdDictionary
+{
+private:
+    std::unordered_map<std::string, uint32_t> ordinals_;
+    std::vector<std::string> doc_ids_; // ordinal -> UUID
+    pthread_rwlock_t lock_;
+
+    DocIdDictionary();
+
+public:
+    ~DocIdDictionary();
+    DocIdDictionary(const DocIdDictionary &) = delete;
+    DocIdDictionary &operator=(const DocIdDictionary &) = delete;
+
+    // Singleton shared by the index, the caches and the search service
+    static DocIdDictionary &instance()
+    {
+        static DocIdDictionary dictionary;
+        return dictionary;
+    }
+
+    // returns the ordinal of doc_id, assigning the next free one if it is new
+    uint32_t get_or_assign(const std::string &doc_id);
+
+    // returns the ordinal of doc_id if it was seen before
+    std::optional<uint32_t> find(const std::string &doc_id);
+
+    // returns the UUID for an ordinal (empty string if unknown)
+    std::string doc_id(uint32_t ordinal);
+
+    // number of ordinals handed out so far, every ordinal is below this
+    size_t size();
+};
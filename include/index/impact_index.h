@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <pthread.h>
+#include "inverted_index.h"
+#include "top_k_evaluator.h"
+#include "../models/idf_table.h"
+
+// Impact-ordered copy of the inverted index. After an IDF refresh each posting's
+// tf x idf is precomputed and quantized to an 8 or 16 bit integer impact, and every
+// word's postings are grouped by impact, highest first. A query then adds integers
+// segment by segment (score-at-a-time) and stops as soon as the impacts left to
+// process cannot change which documents make the top-k.
+//
+// Quantization trades a little ranking precision for much cheaper scoring; callers
+// rescore the returned candidates exactly (see SearchService). A rebuild costs a pass
+// over every posting, the IDF updater runs it at most once per IMPACT_REBUILD_INTERVAL_MS.
+// Documents written after the last rebuild are missing until the next one.
+class ImpactIndex
+{
+private:
+    // postings of one word sharing the same impact, ordinals delta + StreamVByte coded
+    struct Segment
+    {
+        uint16_t impact;
+        uint32_t count;
+        uint32_t offset; // start in ImpactList::doc_bytes
+    };
+
+    struct ImpactList
+    {
+        std::vector<Segment> segments; // by impact, highest first
+        std::vector<uint8_t> doc_bytes;
+    };
+
+    // immutable, readers keep it alive through a shared_ptr while a rebuild swaps in the next
+    struct Snapshot
+    {
+        std::unordered_map<std::string, ImpactList> lists;
+        double score_per_impact = 0.0; // impact units -> tf-idf score
+        size_t num_docs = 0;           // every ordinal is below this
+    };
+
+    unsigned bits_;
+    std::shared_ptr<const Snapshot> snapshot_;
+    pthread_mutex_t lock_; // only guards swapping snapshot_
+
+    std::shared_ptr<const Snapshot> snapshot();
+
+public:
+    // bits is the impact width, 8 or 16
+    explicit ImpactIndex(unsigned bits = 8);
+    ~ImpactIndex();
+
+    // requantizes every posting of index with the current idf values
+    void rebuild(InvertedIndex &index, IDFTable &idf_table);
+
+    // false until the first rebuild
+    bool ready();
+
+    // best top_k documents for the distinct query words, highest approximate score first
+    // (impact sum scaled back to tf-idf). Ranks by quantized scores, so it may differ from
+    // TopKEvaluator near ties.
+    std::vector<ScoredDoc> top_k(const std::vector<std::string> &words, size_t top_k);
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <pthread.h>
+#include "../models/term_frequency.h"
+#include "posting_list.h"
+
+// Resident inverted index (word -> postings) kept in memory for the search path.
+// It is built once from the term_frequency table at startup and then patched by
+// the document write path, postgres stays the durable copy.
+class InvertedIndex
+{
+private:
+    // word -> postings sorted by document ordinal
+    std::unordered_map<std::string, PostingList> postings_;
+    // document ordinal -> words of that document, needed to drop its postings on delete
+    std::unordered_map<uint32_t, std::vector<std::string>> doc_words_;
+    // many searches read the index at once, writers are rare
+    pthread_rwlock_t lock_;
+
+public:
+    InvertedIndex();
+    ~InvertedIndex();
+
+    // replaces the whole index with the given rows of the term_frequency table
+    void load(const std::vector<TermFrequency> &records);
+
+    // adds the postings of a freshly committed document
+    void add_document(const std::string &doc_id, const std::vector<TermFrequency> &term_freqs);
+
+    // removes every posting of the document, returns false if it was not indexed
+    bool remove_document(const std::string &doc_id);
+
+    // calls fn(lists) with the posting list of every word (nullptr if the word is unknown)
+    // while holding the read lock, the pointers are only valid inside fn
+    template <typename Fn>
+    void with_postings(const std::vector<std::string> &words, Fn fn);
+
+    // calls fn(word, list) for every word while holding the read lock
+    template <typename Fn>
+    void for_each_list(Fn fn);
+
+    size_t document_count();
+    size_t vocabulary_size();
+};
+
+template <typename Fn>
+void InvertedIndex::with_postings(const std::vector<std::string> &words, Fn fn)
+{
+    pthread_rwlock_rdlock(&lock_);
+    try
+    {
+        std::vector<const PostingList *> lists;
+        lists.reserve(words.size());
+        for (const auto &word : words)
+        {
+            auto it = postings_.find(word);
+            lists.push_back(it != postings_.end() ? &it->second : nullptr);
+        }
+        fn(lists);
+    }
+    catch (...)
+    {
+        // never leave the index locked if the callback throws
+        pthread_rwlock_unlock(&lock_);
+        throw;
+    }
+    pthread_rwlock_unlock(&lock_);
+}
+
+template <typename Fn>
+void InvertedIndex::for_each_list(Fn fn)
+{
+    pthread_rwlock_rdlock(&lock_);
+    try
+    {
+        for (const auto &[word, list] : postings_)
+            fn(word, list);
+    }
+    catch (...)
+    {
+        pthread_rwlock_unlock(&lock_);
+        throw;
+    }
+    pthread_rwlock_unlock(&lock_);
+}
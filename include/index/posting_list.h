@@ -0,0 +1,182 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// one entry of a posting list: dense document ordinal and its term frequency
+struct Posting
+{
+    uint32_t doc;
+    float word_frequency;
+};
+
+// summary of one fixed-size block of postings, lets Block-Max WAND bound a block's
+// contribution without looking at its postings
+struct PostingBlock
+{
+    uint32_t last_doc;         // ordinal of the last posting in the block
+    float max_word_frequency;  // bounds of the (dequantized) word_frequency inside the block
+    float min_word_frequency;
+    uint32_t doc_offset;       // start of the block's encoded ordinals in doc_bytes_
+    float frequency_base;      // word_frequency = frequency_base + quantized * frequency_step
+    float frequency_step;
+};
+
+// Posting list of a single word, kept sorted by document ordinal and split into
+// blocks of BLOCK_SIZE postings. Used both by the in-memory index and as the value
+// of the term frequency cache.
+//
+// Postings are stored compressed: per block the ordinals are delta coded against the
+// previous posting and packed with StreamVByte, the frequencies are quantized to 16 bits
+// between the block's min and max. A typical posting takes 3-4 bytes instead of a
+// UUID string plus a float. Readers go through Cursor or for_each(), which decode one
+// block at a time into a fixed buffer.
+class PostingList
+{
+private:
+    std::vector<uint8_t> doc_bytes_;     // StreamVByte coded ordinal deltas, block after block
+    std::vector<uint16_t> frequencies_;  // quantized word_frequency, one per posting
+    std::vector<PostingBlock> blocks_;
+    size_t size_ = 0;
+    // bounds of word_frequency over the list, used for top-k score upper bounds
+    float max_word_frequency_ = 0.0f;
+    float min_word_frequency_ = 0.0f;
+
+    // number of postings in block b
+    size_t block_size(size_t b) const;
+
+    // decodes the ordinals of block b into docs, returns how many there are
+    size_t decode_docs(size_t b, uint32_t *docs) const;
+
+    float frequency(size_t b, size_t index) const
+    {
+        const PostingBlock &block = blocks_[b];
+        return block.frequency_base + frequencies_[b * BLOCK_SIZE + index] * block.frequency_step;
+    }
+
+    // decodes every posting from block `first` onwards and drops them from the list
+    std::vector<Posting> take_from(size_t first);
+
+    // appends sorted postings after the last block, starting a new block every BLOCK_SIZE
+    void append_blocks(const std::vector<Posting> &postings);
+
+    // recomputes the list bounds from the block summaries
+    void update_bounds();
+
+    // first block whose last ordinal is >= doc, blocks_.size() if there is none
+    size_t find_block(uint32_t doc) const;
+
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    // returned by Cursor::doc() once the cursor ran past the last posting
+    static constexpr uint32_t END = std::numeric_limits<uint32_t>::max();
+
+    // block summary of a list that has no block left, contributes nothing
+    static const PostingBlock EXHAUSTED_BLOCK;
+
+    // forward only iterator used by the document-at-a-time evaluators. It keeps the
+    // ordinals of the current block decoded, frequencies are dequantized on access.
+    class Cursor
+    {
+    private:
+        const PostingList *list_;
+        size_t block_;  // block currently decoded into docs_
+        size_t pos_;    // position inside that block
+        size_t count_;  // postings in that block
+        // block the evaluator is looking at, may run ahead of block_ (shallow move)
+        size_t shallow_block_;
+        uint32_t docs_[BLOCK_SIZE];
+
+        // decodes block b (or marks the cursor exhausted past the last block)
+        void load_block(size_t b);
+
+    public:
+        explicit Cursor(const PostingList &list);
+
+        uint32_t doc() const { return pos_ < count_ ? docs_[pos_] : END; }
+        float word_frequency() const { return list_->frequency(block_, pos_); }
+
+        void next()
+        {
+            if (++pos_ == count_)
+                load_block(block_ + 1);
+        }
+
+        // moves to the first posting with doc >= target
+        void next_geq(uint32_t target);
+
+        // moves only the block pointer to the block that may contain target,
+        // without touching any postings. Returns false if no block is left.
+        bool shallow_next_geq(uint32_t target);
+
+        // summary of the block selected by shallow_next_geq, EXHAUSTED_BLOCK past the end
+        const PostingBlock &shallow_block() const
+        {
+            return shallow_block_ < list_->blocks_.size() ? list_->blocks_[shallow_block_] : EXHAUSTED_BLOCK;
+        }
+    };
+
+    PostingList() = default;
+
+    // takes postings in any order and sorts them by ordinal
+    explicit PostingList(std::vector<Posting> postings);
+
+    // inserts or updates the posting of doc, appending is the common case
+    void add(uint32_t doc, float word_frequency);
+
+    // removes the posting of doc, returns false if it was not present
+    bool remove(uint32_t doc);
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // largest ordinal in the list, only valid when not empty
+    uint32_t max_doc() const { return blocks_.back().last_doc; }
+
+    float max_word_frequency() const { return max_word_frequency_; }
+    float min_word_frequency() const { return min_word_frequency_; }
+
+    const std::vector<PostingBlock> &blocks() const { return blocks_; }
+
+    // bytes held by the compressed postings and block summaries
+    size_t memory_usage() const;
+
+    Cursor cursor() const { return Cursor(*this); }
+
+    // calls fn(doc, word_frequency) for every posting in ordinal order, decoding block by block
+    template <typename Fn>
+    void for_each(Fn fn) const;
+
+    // calls fn(docs, word_frequencies, n) once per block with its decoded postings,
+    // feeds the term-at-a-time score kernel
+    template <typename Fn>
+    void for_each_block(Fn fn) const;
+};
+
+template <typename Fn>
+void PostingList::for_each(Fn fn) const
+{
+    for_each_block([&](const uint32_t *docs, const float *word_frequencies, size_t n)
+                   {
+                       for (size_t i = 0; i < n; i++)
+                           fn(docs[i], word_frequencies[i]);
+                   });
+}
+
+template <typename Fn>
+void PostingList::for_each_block(Fn fn) const
+{
+    uint32_t docs[BLOCK_SIZE];
+    float word_frequencies[BLOCK_SIZE];
+    for (size_t b = 0; b < blocks_.size(); b++)
+    {
+        size_t count = decode_docs(b, docs);
+        for (size_t i = 0; i < count; i++)
+        {
+            word_frequencies[i] = frequency(b, i);
+        }
+        fn(docs, word_frequencies, count);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// which implementation ScoreAccumulator::add_block runs
+enum class ScoreKernel
+{
+    SCALAR,
+    AVX2
+};
+
+// Flat score array indexed by document ordinal, reused by every query of a thread.
+// stamps[doc] == epoch marks the slots written by the current query so nothing
+// has to be cleared between queries.
+struct ScoreAccumulator
+{
+    std::vector<double> scores;
+    std::vector<uint32_t> stamps;
+    std::vector<uint32_t> touched;
+    uint32_t epoch = 0;
+
+    void begin(size_t num_docs);
+
+    void add(uint32_t doc, double value)
+    {
+        if (stamps[doc] != epoch)
+        {
+            stamps[doc] = epoch;
+            scores[doc] = 0.0;
+            touched.push_back(doc);
+        }
+        scores[doc] += value;
+    }
+
+    // term-at-a-time kernel: scores[docs[i]] += word_frequencies[i] * idf for one decoded
+    // block. docs must be distinct, which holds for any block of a posting list. Uses AVX2
+    // when the CPU has it; both kernels produce bit identical scores.
+    void add_block(const uint32_t *docs, const float *word_frequencies, size_t n, double idf)
+    {
+        add_block(docs, word_frequencies, n, idf, best_kernel());
+    }
+
+    // same with an explicit kernel, used by the benchmark. AVX2 falls back to scalar
+    // on CPUs without it.
+    void add_block(const uint32_t *docs, const float *word_frequencies, size_t n, double idf, ScoreKernel kernel);
+
+    // AVX2 if this CPU supports it, SCALAR otherwise
+    static ScoreKernel best_kernel();
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// StreamVByte integer coding (Lemire et al.): each value takes 1-4 data bytes and the
+// lengths are kept apart in control bytes, 2 bits per value. Because the lengths of
+// four values sit in one byte, a decoder can expand four values with one shuffle.
+namespace stream_vbyte
+{
+    // number of control bytes for n values
+    inline size_t control_bytes(size_t n) { return (n + 3) / 4; }
+
+    // worst case encoded size for n values
+    inline size_t max_encoded_bytes(size_t n) { return control_bytes(n) + 4 * n; }
+
+    // writes n values to out (control bytes first, then data), returns bytes written
+    size_t encode(const uint32_t *in, size_t n, uint8_t *out);
+
+    // reads n values written by encode. Up to 16 bytes past the encoded data may be
+    // read when buffer_end allows it (SIMD path), returns the encoded size consumed.
+    size_t decode(const uint8_t *in, const uint8_t *buffer_end, size_t n, uint32_t *out);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "posting_list.h"
+
+// one distinct query word: its posting list and the idf its postings are weighted with
+struct QueryTerm
+{
+    const PostingList *postings;
+    double idf;
+};
+
+// a ranked document, score is the raw tf-idf sum (not yet averaged over the query words)
+struct ScoredDoc
+{
+    uint32_t doc;
+    double score;
+};
+
+// Ranking order shared by every evaluator: higher score first, ties go to the lower
+// ordinal so that all strategies return exactly the same list.
+inline bool ranks_before(const ScoredDoc &a, const ScoredDoc &b)
+{
+    return a.score > b.score || (a.score == b.score && a.doc < b.doc);
+}
+
+// how the top-k documents of a query are computed, every strategy returns the same ranking
+enum class TopKStrategy
+{
+    EXHAUSTIVE,     // score every posting
+    WAND,           // skip documents whose score upper bound cannot enter the top-k
+    BLOCK_MAX_WAND  // WAND that also skips whole posting blocks using per-block maxima
+};
+
+class TopKEvaluator
+{
+public:
+    static std::vector<ScoredDoc> evaluate(const std::vector<QueryTerm> &terms, size_t top_k, TopKStrategy strategy);
+
+    // scores every posting of every term into a flat per-thread accumulator
+    // indexed by ordinal and returns the best top_k documents in ranking order
+    static std::vector<ScoredDoc> exhaustive(const std::vector<QueryTerm> &terms, size_t top_k);
+
+    // document-at-a-time WAND: keeps a per-term upper bound (max tf x idf) and only
+    // fully scores documents whose summed bounds can beat the current k-th score
+    static std::vector<ScoredDoc> wand(const std::vector<QueryTerm> &terms, size_t top_k);
+
+    // Block-Max WAND: after a WAND pivot is found, the per-block maxima of the lists
+    // involved are checked as well, and whole blocks are skipped when even their
+    // maxima cannot beat the k-th score (a common word mixed with rare ones)
+    static std::vector<ScoredDoc> block_max_wand(const std::vector<QueryTerm> &terms, size_t top_k);
+};
+
+// parses "exhaustive" / "wand" / "block_max_wand", anything else falls back to def
+TopKStrategy parse_top_k_strategy(const std::string &name, TopKStrategy def);
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <time.h>
+#include <unordered_map>
+#include <vector>
+#include <pthread.h>
+#include "idf_stats.h"
+
+// Number of documents containing each word plus the corpus size, kept current by the
+// write path instead of being recounted from term_frequency. Loaded once at startup
+// from the word_df table, then every committed create/delete applies its delta here
+// (and to word_df in the same transaction), so an IDF refresh needs no db scan.
+// Writes also wake the IDF updater, which otherwise sleeps without a timeout.
+class DocumentFrequencies
+{
+private:
+    std::unordered_map<std::string, int> counts_;
+    int total_documents_ = 0;
+    bool changed_ = true;     // since the last wait_for_changes
+    uint64_t changes_ = 0;    // writes so far, tells the waiter whether a burst is still going
+    timespec first_change_{}; // CLOCK_MONOTONIC time of the oldest change not yet taken
+    pthread_mutex_t mutex_;
+    pthread_cond_t changed_cond_; // signalled on every change
+
+    // records a change, needs mutex_
+    void mark_changed();
+
+    DocumentFrequencies();
+
+public:
+    ~DocumentFrequencies();
+    DocumentFrequencies(const DocumentFrequencies &) = delete;
+    DocumentFrequencies &operator=(const DocumentFrequencies &) = delete;
+
+    // Singleton shared by the write path and the IDF updater
+    static DocumentFrequencies &instance()
+    {
+        static DocumentFrequencies frequencies;
+        return frequencies;
+    }
+
+    // replaces all counts, called before any write is served
+    void load(const std::vector<IDFStats> &stats, int total_documents);
+
+    // a committed document with these distinct words
+    void add_document(const std::vector<std::string> &words);
+
+    // a committed delete of a document with these distinct words
+    void remove_document(const std::vector<std::string> &words);
+
+    // Blocks until a write happened since the last call, then until writes paused for
+    // debounce_ms (or max_delay_ms passed since the first of them) and copies the counts
+    // out. A burst of writes becomes one refresh, and none waits longer than max_delay_ms.
+    // With idle_timeout_ms >= 0 it gives up when no write came in that long and returns
+    // false without touching stats.
+    bool wait_for_changes(long debounce_ms, long max_delay_ms, std::vector<IDFStats> &stats, int &total_documents,
+                          long idle_timeout_ms = -1);
+};
@@ -1,21 +1,41 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <pthread.h>
+#include "../utils/epoch_domain.h"
 
+// word -> IDF, read by every search and replaced as a whole by the IDF updater.
+// The updater builds a complete new table off to the side and publishes it with one
+// atomic pointer swap; readers never take a lock. The table a reader may still be
+// looking at is freed through an EpochDomain once the reader is done.
 class IDFTable {
 private:
-    // storing the word : IDF in an unordered_map in-memory
-    std::unordered_map<std::string, double> idf_map_;
-    // mutex to ensure consistency
-    pthread_mutex_t mutex_;
+    // storing the word : IDF in an unordered_map in-memory, never modified once published
+    using Snapshot = std::unordered_map<std::string, double>;
+
+    std::atomic<const Snapshot *> snapshot_;
+    // bumped by every publish that changes a value or the set of words
+    std::atomic<uint64_t> generation_{0};
+    EpochDomain epochs_;
+    // serializes publishers, readers never touch it
+    pthread_mutex_t publish_mutex_;
 
 public:
     IDFTable();
     ~IDFTable();
 
-    // Thread-safe setters/getters
-    void set_idf(const std::string &word, double value);
+    // replaces the whole table, words missing from idfs are dropped. Wait-free for readers.
+    void publish(std::unordered_map<std::string, double> idfs);
+
+    // 0.0 for words not in the table, never blocks
     double get_idf(const std::string &word);
 
+    // number of words in the current table
+    size_t size();
+
+    // changes whenever any idf value changed, results ranked under an older
+    // generation may be stale
+    uint64_t generation() const { return generation_.load(std::memory_order_acquire); }
 };
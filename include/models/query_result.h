@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "search_result.h"
+
+// Ranking of one normalized query, the value of the query result cache. Only valid
+// while both generations it was computed under are still current.
+struct QueryResult {
+    uint64_t idf_generation;              // IDFTable::generation() before ranking
+    uint64_t corpus_generation;           // CacheManager::corpusGeneration() before ranking
+    std::vector<SearchResult> results;    // doc_id and summed score (not yet averaged), text is left empty
+};
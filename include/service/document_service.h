@@ -3,23 +3,41 @@
 #include "../db/term_frequency_repository.h"
 #include "../utils/tokenizer.h"
 #include "../models/document.h"
+#include "../index/inverted_index.h"
 #include <string>
 #include <optional>
+#include <vector>
 
 class DocumentService
 {
     DocumentRepository *doc_repo_;
     TermFrequencyRepository *tf_repo_;
-    DBConnection *db_;
+    ConnectionHandle *db_; // connection is only taken for the duration of each write
+    InvertedIndex *index_; // optional, kept in sync with every write when present
+
+    // applies a committed create (added) or delete of the document to the cached
+    // posting lists of its words, leaving every other cached word alone
+    void patch_term_cache(const std::string &doc_id, const std::vector<TermFrequency> &term_freqs, bool added);
+
+    // makes a committed create visible: in-memory index, document frequencies and caches
+    void apply_created(const std::string &doc_id, const std::vector<TermFrequency> &term_freqs, const std::vector<std::string> &words);
+
+    // create_document in libpq pipeline mode: one round trip for the whole transaction
+    std::optional<std::string> create_document_pipelined(const std::string &text);
 
 public:
     DocumentService(DocumentRepository *doc_repo,
                     TermFrequencyRepository *tf_repo,
-                    DBConnection *db)
-        : doc_repo_(doc_repo), tf_repo_(tf_repo), db_(db) {}
+                    ConnectionHandle *db,
+                    InvertedIndex *index = nullptr)
+        : doc_repo_(doc_repo), tf_repo_(tf_repo), db_(db), index_(index) {}
 
     std::optional<std::string> create_document(const std::string &text);
 
+    // creates all texts in a single transaction, returns their doc_ids in order.
+    // All or nothing: on failure none of them exists.
+    std::optional<std::vector<std::string>> create_documents(const std::vector<std::string> &texts);
+
     std::optional<Document> get_document_by_id(const std::string &doc_id);
 
     bool delete_document_by_id(const std::string &doc_id);
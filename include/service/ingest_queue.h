@@ -0,0 +1,81 @@
+#pragma once
+#include "../db/connection_pool.h"
+#include "../index/inverted_index.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <pthread.h>
+
+// Group commit for document creates. Request threads submit their text to a bounded
+// queue and block; writer threads take up to max_batch documents at a time (waiting at
+// most linger_ms for a batch to fill) and create them in one transaction on one pooled
+// connection, so N concurrent creates cost one commit instead of N.
+class IngestQueue
+{
+private:
+    // one waiting request, lives on the submitting thread's stack
+    struct Pending
+    {
+        const std::string *text;
+        timespec enqueued; // CLOCK_MONOTONIC, starts the linger of its batch
+        std::optional<std::string> doc_id;
+        bool done = false;
+    };
+
+    ConnectionPool *db_pool_;
+    InvertedIndex *index_; // optional, kept in sync like DocumentService does
+    size_t capacity_;
+    size_t max_batch_;
+    long linger_ms_;
+
+    std::deque<Pending *> queue_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t not_empty_; // writers wait for work
+    pthread_cond_t not_full_;  // submitters wait for room
+    pthread_cond_t done_;      // submitters wait for their batch, broadcast per batch
+
+    // reported after every batch (debug)
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> documents_{0};
+    std::atomic<uint64_t> commit_us_{0};
+
+    // summary of the batches since the last report, logged at info level once
+    // STATS_INTERVAL_MS passed (by the writer finishing the first batch after that)
+    static constexpr long STATS_INTERVAL_MS = 10000;
+    struct Window
+    {
+        uint64_t batches = 0;
+        uint64_t documents = 0;
+        uint64_t commit_us = 0;
+        uint64_t max_commit_us = 0;
+        size_t max_depth = 0;
+        timespec since; // CLOCK_MONOTONIC start of the window
+    };
+    Window window_;
+    pthread_mutex_t stats_mutex_;
+
+    // adds a committed batch to the window, logs and restarts it when it is due
+    void record_batch(size_t documents, long commit_us, size_t depth);
+
+    static void *writer_thread(void *arg);
+
+    // blocks until a batch is due, then moves it out of the queue. depth is what was left
+    std::vector<Pending *> take_batch(size_t &depth);
+
+    // creates the batch and completes its requests
+    void write_batch(const std::vector<Pending *> &batch, size_t depth);
+
+public:
+    IngestQueue(ConnectionPool *db_pool, InvertedIndex *index, int writers, size_t capacity, size_t max_batch,
+                long linger_ms);
+    ~IngestQueue();
+    IngestQueue(const IngestQueue &) = delete;
+    IngestQueue &operator=(const IngestQueue &) = delete;
+
+    // creates the document through the next batch, returns its doc_id once committed
+    std::optional<std::string> submit(const std::string &text);
+};
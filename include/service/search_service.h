@@ -5,17 +5,41 @@
 #include "../models/document.h"
 #include "../models/idf_table.h"
 #include "../models/search_result.h"
+#include "../index/inverted_index.h"
+#include "../index/top_k_evaluator.h"
+#include "../index/impact_index.h"
+#include <functional>
+#include <future>
 #include <string>
 #include <optional>
+#include <memory>
+#include <vector>
 
 class SearchService
 {
     DocumentRepository *doc_repo_;
     TermFrequencyRepository *tf_repo_;
     IDFTable *idf_table_;
+    InvertedIndex *index_; // when set, postings are read from memory instead of cache/db
+    ImpactIndex *impacts_; // when set (with index_), candidates come from quantized impacts
+
+    // lists of the tokens, false when the db lookup of missed words failed (lists then
+    // only hold what was cached). while_fetching gets the cached lists after that lookup
+    // is sent and before its result is waited for.
+    bool postings_from_cache(const std::vector<std::string> &tokens,
+                             std::vector<std::shared_ptr<const PostingList>> &lists,
+                             const std::function<void(const std::vector<std::shared_ptr<const PostingList>> &)> &while_fetching);
+    std::vector<ScoredDoc> rescore(std::vector<ScoredDoc> candidates, const std::vector<std::string> &tokens,
+                                   const std::vector<double> &idfs);
+    // nullopt when postings could not be read, the ranking would be incomplete. While
+    // postings are read from the db, early_texts is set to a read of the uncached texts of
+    // likely (doc_ids of an earlier ranking of the query) and of the cached words' top_k.
+    std::optional<std::vector<ScoredDoc>> rank(const std::vector<std::string> &tokens, int top_k,
+                                               const std::vector<std::string> &likely,
+                                               std::future<std::vector<Document>> &early_texts);
 
 public:
-    SearchService(DocumentRepository *doc_repo,TermFrequencyRepository *tf_repo,IDFTable *idf_table);
+    SearchService(DocumentRepository *doc_repo,TermFrequencyRepository *tf_repo,IDFTable *idf_table, InvertedIndex *index = nullptr, ImpactIndex *impacts = nullptr);
 
     std::vector<SearchResult> search(const std::string& query, int top_k=3);
 };
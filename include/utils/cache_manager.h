@@ -4,8 +4,12 @@
 #include <vector>
 #include <utility>
 #include "utils/lru_cache.h"
+#include "utils/logger.h"
+#include "index/posting_list.h"
+#include "models/query_result.h"
+#include <atomic>
+#include <cstdint>
 #include <dotenv.h>
-#include <iostream>
 
 // global singleton instance will be created
 // to-do: put values are configurable
@@ -24,21 +28,127 @@ public:
         }
     }
 
-    // Singleton for term frequency cache
-    static LRUCache<std::string, std::vector<std::pair<std::string, float>>> &termFrequencyCache()
+    // number of independently locked shards per cache, roughly the number of worker threads
+    static size_t shardCount()
     {
-        static LRUCache<std::string, std::vector<std::pair<std::string, float>>> tf_cache(std::stoi(dotenv::getenv("TERM_FREQUENCY_CACHE_SIZE")));
+        static const size_t shards = std::stoul(dotenv::getenv("CACHE_SHARDS", "16"));
+        return shards;
+    }
+
+    // byte budget from env var name, 0 (the default) leaves only the entry limit
+    static size_t byteBudget(const char *name)
+    {
+        return std::stoull(dotenv::getenv(name, "0"));
+    }
+
+    // admission policy from env var name: "tinylfu" or the default "none"
+    static AdmissionPolicy admissionPolicy(const char *name)
+    {
+        return dotenv::getenv(name, "none") == "tinylfu" ? AdmissionPolicy::TINY_LFU : AdmissionPolicy::NONE;
+    }
+
+    // Singleton for term frequency cache (word -> postings keyed by document ordinal).
+    // An entry is charged its postings (memory_usage includes the PostingList itself)
+    // plus the key and bookkeeping. With TERM_FREQUENCY_CACHE_ADMISSION=tinylfu,
+    // long-tail words cannot flush popular ones.
+    static LRUCache<std::string, PostingList> &termFrequencyCache()
+    {
+        static LRUCache<std::string, PostingList> tf_cache(
+            std::stoi(dotenv::getenv("TERM_FREQUENCY_CACHE_SIZE")), shardCount(), byteBudget("TERM_FREQUENCY_CACHE_BYTES"),
+            [](const std::string &word, const PostingList &postings)
+            { return ENTRY_OVERHEAD + word.capacity() + postings.memory_usage(); },
+            admissionPolicy("TERM_FREQUENCY_CACHE_ADMISSION"));
         return tf_cache;
     }
 
-    // Singleton for document cache
+    // Singleton for document cache, an entry is charged the document's text plus the key
     static LRUCache<std::string, std::string> &documentCache()
     {
-        static LRUCache<std::string, std::string> doc_cache(std::stoi(dotenv::getenv("DOCUMENT_CACHE_SIZE")));
+        static LRUCache<std::string, std::string> doc_cache(
+            std::stoi(dotenv::getenv("DOCUMENT_CACHE_SIZE")), shardCount(), byteBudget("DOCUMENT_CACHE_BYTES"),
+            [](const std::string &id, const std::string &content)
+            { return ENTRY_OVERHEAD + sizeof(std::string) + id.capacity() + content.capacity(); });
         return doc_cache;
     }
 
+    // Singleton for query result cache (normalized query + top_k -> ranked doc ids and scores).
+    // Entries carry the generations they were ranked under, see QueryResult.
+    static LRUCache<std::string, QueryResult> &queryResultCache()
+    {
+        static LRUCache<std::string, QueryResult> result_cache(
+            std::stoi(dotenv::getenv("QUERY_RESULT_CACHE_SIZE", "1000")), shardCount(), byteBudget("QUERY_RESULT_CACHE_BYTES"),
+            [](const std::string &key, const QueryResult &result)
+            {
+                size_t bytes = ENTRY_OVERHEAD + sizeof(QueryResult) + key.capacity();
+                for (const auto &r : result.results)
+                    bytes += sizeof(SearchResult) + r.doc_id.capacity();
+                return bytes;
+            });
+        return result_cache;
+    }
+
+    // changes on every document create/delete and impact rebuild, i.e. whenever the set of
+    // rankable documents changed. Cached query results of an older generation are stale.
+    static uint64_t corpusGeneration()
+    {
+        return corpus_generation().load(std::memory_order_acquire);
+    }
+
+    // called after a change to the documents became visible to searches
+    static void corpusChanged()
+    {
+        corpus_generation().fetch_add(1, std::memory_order_release);
+    }
+
+    // changes whenever a committed write touched the word's postings (words share one of
+    // TERM_STRIPES counters). A posting list read from the db is only cached if its
+    // word's generation did not change meanwhile, see SearchService::postings_from_cache.
+    static uint64_t termGeneration(const std::string &word)
+    {
+        return term_stripe(word).load(std::memory_order_acquire);
+    }
+
+    // called after a write touching word committed, before the cached list is patched
+    static void termChanged(const std::string &word)
+    {
+        term_stripe(word).fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    // prints size, current / peak / budget bytes and hit ratio of every cache
+    static void logStats()
+    {
+        logStats("Term frequency cache", termFrequencyCache());
+        logStats("Document cache", documentCache());
+        logStats("Query result cache", queryResultCache());
+    }
+
 private:
+    static constexpr size_t TERM_STRIPES = 1024;
+
+    static std::atomic<uint64_t> &term_stripe(const std::string &word)
+    {
+        static std::atomic<uint64_t> stripes[TERM_STRIPES] = {};
+        return stripes[std::hash<std::string>()(word) % TERM_STRIPES];
+    }
+
+    static std::atomic<uint64_t> &corpus_generation()
+    {
+        static std::atomic<uint64_t> generation{0};
+        return generation;
+    }
+
+    template <typename Cache>
+    static void logStats(const char *name, Cache &cache)
+    {
+        size_t lookups = cache.hits() + cache.misses();
+        LOG_INFO(name << ": " << cache.size() << " entries, " << cache.bytes() << " bytes (peak "
+                      << cache.peak_bytes() << ", budget " << cache.max_bytes() << "), hit ratio "
+                      << (lookups ? static_cast<double>(cache.hits()) / lookups : 0.0));
+    }
+
+    // per entry bookkeeping outside the value: clock slot, index node and shared_ptr control block
+    static constexpr size_t ENTRY_OVERHEAD = 128;
+
     // Prevent external construction
     CacheManager() = default;
 };
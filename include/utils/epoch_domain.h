@@ -0,0 +1,68 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <pthread.h>
+
+// Epoch-based reclamation for read-mostly data published through an atomic pointer.
+// A reader pins the domain for the duration of its access, which is two atomic stores
+// and never waits. A writer swaps in a new version and retires the old one; it is freed
+// once every reader that could still see it has unpinned. Readers must not hold a
+// pointer past their Guard.
+class EpochDomain
+{
+private:
+    // upper bound on threads reading at the same time, each thread owns one slot
+    static constexpr size_t MAX_READERS = 1024;
+
+    // epoch the thread pinned at, 0 while it is not reading
+    struct alignas(64) ReaderSlot
+    {
+        std::atomic<uint64_t> epoch{0};
+    };
+
+    struct Retired
+    {
+        uint64_t epoch; // global epoch when it was unpublished
+        std::function<void()> free;
+    };
+
+    std::unique_ptr<ReaderSlot[]> readers_;
+    std::atomic<uint64_t> epoch_{1};
+    std::vector<Retired> retired_;
+    pthread_mutex_t retire_lock_;
+
+    // frees everything no pinned reader can still hold, needs retire_lock_
+    void collect();
+
+public:
+    // keeps what the reader loaded alive until it goes out of scope
+    class Guard
+    {
+    private:
+        ReaderSlot *slot_;
+        bool outer_; // nested guards leave the slot to the outermost one
+
+    public:
+        explicit Guard(EpochDomain &domain);
+        ~Guard()
+        {
+            if (outer_)
+                slot_->epoch.store(0, std::memory_order_release);
+        }
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+    };
+
+    EpochDomain();
+    ~EpochDomain();
+    EpochDomain(const EpochDomain &) = delete;
+    EpochDomain &operator=(const EpochDomain &) = delete;
+
+    // call after the old version was unpublished (the pointer swap happened), free runs
+    // once no reader pinned before the swap is left
+    void retire(std::function<void()> free);
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Count-Min sketch of recent access frequencies, the popularity estimate behind the
+// cache's TinyLFU admission. Every key maps to one counter in each of DEPTH rows and its
+// estimate is the smallest of them. Counters saturate at MAX_COUNT, and once sample_size
+// accesses were recorded all counters are halved, so old popularity fades out.
+//
+// Counters are relaxed atomics so readers can record under a shared lock. Two
+// concurrent increments may lose one, which only makes an estimate slightly low.
+class FrequencySketch
+{
+private:
+    static constexpr size_t DEPTH = 4;
+    static constexpr uint8_t MAX_COUNT = 15;
+
+    std::unique_ptr<std::atomic<uint8_t>[]> counters_; // DEPTH rows of width_ counters
+    size_t width_;                                     // power of two
+    size_t sample_size_;
+    std::atomic<size_t> additions_{0};
+
+    // counter of hash in row
+    std::atomic<uint8_t> &counter(uint64_t hash, size_t row) const
+    {
+        static constexpr uint64_t SEEDS[DEPTH] = {0xC3A5C85C97CB3127ull, 0xB492B66FBE98F273ull,
+                                                  0x9AE16A3B2F90404Full, 0xCBF29CE484222325ull};
+        uint64_t h = (hash + SEEDS[row]) * SEEDS[row];
+        return counters_[row * width_ + ((h >> 32) & (width_ - 1))];
+    }
+
+    // halves every counter, called once per sample
+    void age()
+    {
+        for (size_t i = 0; i < DEPTH * width_; i++)
+            counters_[i].store(counters_[i].load(std::memory_order_relaxed) >> 1, std::memory_order_relaxed);
+    }
+
+public:
+    // capacity is the number of entries the owning cache holds
+    explicit FrequencySketch(size_t capacity)
+    {
+        width_ = 64;
+        while (width_ < 2 * capacity)
+            width_ <<= 1;
+        sample_size_ = 10 * std::max<size_t>(capacity, 1);
+        counters_.reset(new std::atomic<uint8_t>[DEPTH * width_]);
+        for (size_t i = 0; i < DEPTH * width_; i++)
+            counters_[i].store(0, std::memory_order_relaxed);
+    }
+
+    // records one access of the key with this hash
+    void record(uint64_t hash)
+    {
+        for (size_t row = 0; row < DEPTH; row++)
+        {
+            std::atomic<uint8_t> &c = counter(hash, row);
+            uint8_t value = c.load(std::memory_order_relaxed);
+            if (value < MAX_COUNT)
+                c.store(value + 1, std::memory_order_relaxed);
+        }
+
+        // exactly one caller sees the count reach the sample size
+        if (additions_.fetch_add(1, std::memory_order_relaxed) + 1 == sample_size_)
+        {
+            age();
+            additions_.fetch_sub(sample_size_ / 2, std::memory_order_relaxed);
+        }
+    }
+
+    // estimated recent accesses of the key with this hash
+    uint8_t frequency(uint64_t hash) const
+    {
+        uint8_t estimate = MAX_COUNT;
+        for (size_t row = 0; row < DEPTH; row++)
+            estimate = std::min(estimate, counter(hash, row).load(std::memory_order_relaxed));
+        return estimate;
+    }
+};
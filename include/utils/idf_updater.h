@@ -1,5 +1,15 @@
 #pragma once
 #include "../models/idf_table.h"
+#include "../index/inverted_index.h"
+#include "../index/impact_index.h"
 
-// Function that will run inside pthread
+// what the updater thread works on, index and impacts may be null
+struct IDFUpdaterArgs
+{
+    IDFTable *idf_table;
+    InvertedIndex *index;
+    ImpactIndex *impacts; // requantized from index after every refresh
+};
+
+// Function that will run inside pthread, arg is an IDFUpdaterArgs*
 void* idf_updater_thread(void* arg);
@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <time.h>
+
+enum class LogLevel : int
+{
+    Debug = 0,
+    Info = 1,
+    Warn = 2,
+    Error = 3,
+    Off = 4
+};
+
+// levels below this are compiled out, their arguments are never evaluated
+// (build with -DLOG_COMPILE_LEVEL=1 to drop debug lines from the binary)
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 0
+#endif
+
+// Asynchronous logger. A log call formats its line and hands it to the calling thread's
+// own ring buffer, which only that thread writes and only the flusher thread reads, so
+// logging takes no lock and makes no syscall. The flusher drains every ring each
+// FLUSH_INTERVAL_MS (sooner for warnings and errors) and writes the lines in time order
+// with one write per stream: errors and warnings to stderr, the rest to stdout. A line
+// that finds its ring full is dropped and counted rather than blocking the request.
+class Logger
+{
+private:
+    static constexpr size_t RING_SIZE = 1024; // lines per thread
+    static constexpr long FLUSH_INTERVAL_MS = 20;
+
+    struct Line
+    {
+        timespec time; // CLOCK_REALTIME when it was logged
+        LogLevel level;
+        std::string text;
+    };
+
+    // single producer (its thread) / single consumer (the flusher)
+    struct Ring
+    {
+        Line lines[RING_SIZE];
+        std::atomic<size_t> head{0}; // next slot the thread writes
+        std::atomic<size_t> tail{0}; // next slot the flusher reads
+        std::atomic<bool> orphaned{false}; // thread exited, freed once drained
+        int thread_number;
+    };
+
+    // registers the thread's ring on its first log line, marks it orphaned at thread exit
+    struct ThreadRing
+    {
+        std::shared_ptr<Ring> ring;
+        ~ThreadRing();
+    };
+
+    std::vector<std::shared_ptr<Ring>> rings_; // guarded by lock_
+    int next_thread_number_ = 1;
+    std::atomic<uint64_t> dropped_{0};
+    uint64_t reported_dropped_ = 0;
+
+    pthread_mutex_t lock_;
+    pthread_mutex_t flush_lock_; // one drain at a time (flusher thread or flush())
+    pthread_cond_t wake_;
+    bool stopping_ = false;
+    bool flusher_started_ = false; // without it every line is written right away
+    pthread_t flusher_;
+
+    static std::atomic<int> runtime_level_;
+
+    Logger();
+    ~Logger();
+
+    Ring &thread_ring();
+    static void *flusher_thread(void *arg);
+
+    // moves every queued line out of the rings and writes them
+    void drain();
+
+public:
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+    static Logger &instance();
+
+    // lines below level are skipped at runtime (LOG_LEVEL in .env, default info)
+    static void set_level(LogLevel level);
+    static bool enabled(LogLevel level)
+    {
+        return static_cast<int>(level) >= runtime_level_.load(std::memory_order_relaxed);
+    }
+    // debug, info, warn, error or off, fallback for anything else
+    static LogLevel parse_level(const std::string &name, LogLevel fallback);
+
+    // the calling thread's stream for formatting a line, emptied and reset. Reused because
+    // constructing an ostringstream per line copies the global locale, which threads
+    // contend on
+    static std::ostringstream &line_stream();
+
+    void write(LogLevel level, std::string text);
+
+    // blocks until everything logged so far has been written
+    void flush();
+
+    // lines lost to full ring buffers so far
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+};
+
+// LOG_INFO("loaded " << n << " documents"); the stream expression is only evaluated when
+// the level is enabled, a disabled line costs one relaxed load (nothing when compiled out)
+#define LOG_AT(level, ...)                                                              \
+    do                                                                                  \
+    {                                                                                   \
+        if (static_cast<int>(level) >= LOG_COMPILE_LEVEL && Logger::enabled(level))     \
+        {                                                                               \
+            std::ostringstream &log_line_ = Logger::line_stream();                      \
+            log_line_ << __VA_ARGS__;                                                   \
+            Logger::instance().write(level, log_line_.str());                          \
+        }                                                                               \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LogLevel::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::Error, __VA_ARGS__)
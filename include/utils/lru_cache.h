@@ -1,213 +1,531 @@
 #pragma once
-#include <map>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 #include <pthread.h>
-#include <optional>
+#include "utils/frequency_sketch.h"
 
-
-// defining node for doubly-linked list
-template <typename KeyType, typename ValueType>
-struct Node {
-    KeyType key;
-    ValueType value;
-    Node* prev;
-    Node* next;
-
-    // initialization of node
-    Node(const KeyType& k, const ValueType& v)
-        : key(k), value(v), prev(nullptr), next(nullptr) {}
+// which new entries a full cache takes in
+enum class AdmissionPolicy
+{
+    NONE,    // every put is cached, evicting whatever the clock picks
+    TINY_LFU // W-TinyLFU: a new entry has to be more popular than the entry it would evict
 };
 
-// defining an LRU template class
-template <typename KeyType, typename ValueType>
-class LRUCache {
+// Sharded cache with CLOCK eviction (an LRU approximation).
+// Keys are spread over independently locked shards by hash, so threads working on
+// different keys do not contend. Inside a shard a hit only sets the entry's reference
+// bit, which needs the shared lock only; writers (put/remove/clear) take it exclusively.
+// On a full shard the clock hand sweeps the slots, clearing reference bits, and evicts
+// the first entry that was not used since the hand last passed it.
+// Values are stored as shared_ptr<const ValueType> and handed out as such, so a hit
+// costs a reference count increment instead of a copy, and a handle stays valid after
+// its entry is evicted or replaced.
+//
+// Besides the entry count the cache can be bounded in bytes: every entry is charged
+// cost(key, value) and a put keeps evicting until its shard is back under its share of
+// the budget. Current and peak bytes are tracked either way.
+//
+// With AdmissionPolicy::TINY_LFU each shard also keeps a FrequencySketch of recent
+// lookups and splits its space into a small window (1%) and the main region. New entries
+// land in the window; an entry the window pushes out only enters the main region if the
+// sketch rates it more popular than the main region's eviction victim, otherwise it is
+// dropped. A stream of one-hit wonders then churns the window instead of flushing the
+// popular entries. Accesses are recorded by get(), so callers look a key up before putting it.
+template <typename KeyType, typename ValueType, typename Hash = std::hash<KeyType>>
+class LRUCache
+{
+public:
+    // bytes an entry is charged with
+    using CostFunction = std::function<size_t(const KeyType &, const ValueType &)>;
+
 private:
-    int capacity;
-    int current_capacity;
-    // cacheMap stores (key,pointer to double LL)
-    std::map<KeyType, Node<KeyType, ValueType>*> cacheMap;
-    // pointer to head of LL (most recently accessed element is stored after head)
-    Node<KeyType, ValueType>* head; 
-    // pointer to tail of LL (remove nodes from tail of LL)
-    Node<KeyType, ValueType>* tail;
-    // lock for multiple access
-    pthread_mutex_t lock; 
-
-    void addNode(Node<KeyType, ValueType>* node);
-    void removeNode(Node<KeyType, ValueType>* node);
-    void moveToFront(Node<KeyType, ValueType>* node);
+    static constexpr size_t DEFAULT_SHARDS = 16;
+
+    // one slot of a clock, a free slot has no value
+    struct Slot
+    {
+        KeyType key;
+        std::shared_ptr<const ValueType> value;
+        uint64_t hash = 0; // mixed hash of key, feeds the sketch
+        size_t cost = 0;
+        std::atomic<bool> referenced{false}; // set by hits under the shared lock
+    };
+
+    // a clock over its own slots with its own entry and byte limits
+    struct Region
+    {
+        std::deque<Slot> slots; // grows on demand, a deque never moves its slots
+        std::vector<size_t> free_slots;
+        size_t capacity = 0;
+        size_t max_bytes = 0; // 0 = no byte limit
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t hand = 0;
+
+        // true if one more entry of cost does not fit without evicting
+        bool full_for(size_t cost) const
+        {
+            return entries + 1 > capacity || (max_bytes > 0 && bytes + cost > max_bytes);
+        }
+
+        bool over() const { return entries > capacity || (max_bytes > 0 && bytes > max_bytes); }
+
+        // stores an entry in a free or new slot, returns the slot
+        size_t insert(const KeyType &key, std::shared_ptr<const ValueType> value, uint64_t hash, size_t cost)
+        {
+            size_t i;
+            if (!free_slots.empty())
+            {
+                i = free_slots.back();
+                free_slots.pop_back();
+            }
+            else
+            {
+                slots.emplace_back();
+                i = slots.size() - 1;
+            }
+            Slot &slot = slots[i];
+            slot.key = key;
+            slot.value = std::move(value);
+            slot.hash = hash;
+            slot.cost = cost;
+            // a new entry starts unreferenced, it has to be hit once to survive a sweep
+            slot.referenced.store(false, std::memory_order_relaxed);
+            entries++;
+            bytes += cost;
+            return i;
+        }
+
+        // empties slot i and puts it on the free list
+        void release(size_t i)
+        {
+            Slot &slot = slots[i];
+            entries--;
+            bytes -= slot.cost;
+            slot.key = KeyType();
+            slot.value.reset();
+            slot.cost = 0;
+            slot.referenced.store(false, std::memory_order_relaxed);
+            free_slots.push_back(i);
+        }
+
+        // the clock's next victim, clearing reference bits on the way. Needs an entry.
+        size_t victim()
+        {
+            while (true)
+            {
+                size_t i = hand;
+                hand = (hand + 1) % slots.size();
+                if (slots[i].value && !slots[i].referenced.exchange(false, std::memory_order_relaxed))
+                    return i;
+            }
+        }
+
+        void reset()
+        {
+            slots.clear();
+            free_slots.clear();
+            entries = 0;
+            bytes = 0;
+            hand = 0;
+        }
+    };
+
+    struct Location
+    {
+        size_t slot;
+        bool window;
+    };
+
+    // padded to a cache line so shard locks do not share lines
+    struct alignas(64) Shard
+    {
+        std::unordered_map<KeyType, Location, Hash> index;
+        Region window; // only used with TINY_LFU
+        Region main;
+        std::unique_ptr<FrequencySketch> sketch; // only with TINY_LFU
+        std::atomic<size_t> hits{0};
+        std::atomic<size_t> misses{0};
+        pthread_rwlock_t lock;
+
+        Shard() { pthread_rwlock_init(&lock, nullptr); }
+        ~Shard() { pthread_rwlock_destroy(&lock); }
+
+        Region &region(const Location &location) { return location.window ? window : main; }
+
+        size_t bytes() const { return window.bytes + main.bytes; }
+
+        void evict(Region &from, size_t i)
+        {
+            index.erase(from.slots[i].key);
+            from.release(i);
+        }
+
+        // moves window slot i into the main region if the sketch rates it more popular
+        // than every main entry it has to displace, otherwise drops it
+        void admit(size_t i)
+        {
+            Slot &candidate = window.slots[i];
+            uint8_t frequency = sketch->frequency(candidate.hash);
+            while (main.entries > 0 && main.full_for(candidate.cost))
+            {
+                size_t victim = main.victim();
+                if (frequency <= sketch->frequency(main.slots[victim].hash))
+                {
+                    evict(window, i);
+                    return;
+                }
+                evict(main, victim);
+            }
+            size_t slot = main.insert(candidate.key, std::move(candidate.value), candidate.hash, candidate.cost);
+            index[main.slots[slot].key] = Location{slot, false};
+            window.release(i);
+        }
+
+        // caches key -> value, replacing an existing entry, and evicts until it fits.
+        // Called under the write lock.
+        void store(const KeyType &key, std::shared_ptr<const ValueType> value, uint64_t hash, size_t cost)
+        {
+            // a replaced entry may change size, so it is charged like a new entry
+            auto it = index.find(key);
+            if (it != index.end())
+            {
+                Location location = it->second;
+                index.erase(it);
+                region(location).release(location.slot);
+            }
+
+            if (main.max_bytes > 0 && cost > main.max_bytes)
+                return;
+
+            if (!sketch)
+            {
+                while (main.entries > 0 && main.full_for(cost))
+                    evict(main, main.victim());
+                size_t slot = main.insert(key, std::move(value), hash, cost);
+                index.emplace(key, Location{slot, false});
+            }
+            else
+            {
+                // new entries start in the window, whatever it pushes out (possibly the
+                // new entry itself) has to win its way into the main region
+                size_t slot = window.insert(key, std::move(value), hash, cost);
+                index.emplace(key, Location{slot, true});
+                while (window.over())
+                    admit(window.victim());
+            }
+        }
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    Hash hash_;
+    CostFunction cost_;
+    std::atomic<size_t> bytes_{0};
+    std::atomic<size_t> peak_bytes_{0};
+
+    uint64_t hash_of(const KeyType &key) const
+    {
+        // mix the hash so shards and sketch rows do not just follow its low bits
+        return hash_(key) * 0x9E3779B97F4A7C15ull;
+    }
+
+    Shard &shard_for(uint64_t hash) const { return *shards_[(hash >> 32) % shards_.size()]; }
+
+    // applies a shard's change in bytes to the totals. Called under the shard's lock, so
+    // the total always equals the sum of the shards and the peak never exceeds the budget.
+    void account(size_t before, size_t after)
+    {
+        if (after <= before)
+        {
+            bytes_.fetch_sub(before - after, std::memory_order_relaxed);
+            return;
+        }
+        size_t now = bytes_.fetch_add(after - before, std::memory_order_relaxed) + (after - before);
+        size_t peak = peak_bytes_.load(std::memory_order_relaxed);
+        while (now > peak && !peak_bytes_.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+        {
+        }
+    }
 
 public:
-    explicit LRUCache(int cap);
-    ~LRUCache();
+    // cap is the total number of entries and max_bytes the total byte budget (0 = none),
+    // both split evenly over the shards. Without a cost function every entry is charged
+    // sizeof(KeyType) + sizeof(ValueType).
+    explicit LRUCache(int cap, size_t num_shards = DEFAULT_SHARDS, size_t max_bytes = 0, CostFunction cost = nullptr,
+                      AdmissionPolicy admission = AdmissionPolicy::NONE);
+
+    LRUCache(const LRUCache &) = delete;
+    LRUCache &operator=(const LRUCache &) = delete;
 
     // Core methods
-    // get will return the value corresponding to the key
-    std::optional<ValueType> get(const KeyType& key);
-    // adding node to cacheMap
-    void put(const KeyType& key, const ValueType& value);
-    // removnig node from cacheMap
-    bool remove(const KeyType& key);
-    // flush the entire cache
+    // get will return a handle to the value of the key, nullptr if it is not cached
+    std::shared_ptr<const ValueType> get(const KeyType &key);
+    // adding entry to the cache, evicts from the key's shard until the entry fits.
+    // An entry larger than a shard's whole budget is not cached.
+    void put(const KeyType &key, std::shared_ptr<const ValueType> value);
+    // same, moving value into a new shared buffer
+    void put(const KeyType &key, ValueType value)
+    {
+        put(key, std::make_shared<const ValueType>(std::move(value)));
+    }
+    // the cached value like get, but neither counted as a lookup nor as an access
+    std::shared_ptr<const ValueType> peek(const KeyType &key);
+    // compare-and-swap: replaces the value of key with value only if it still is expected
+    // (the same shared buffer peek returned). Returns false if it changed or is no longer
+    // cached. value is built by the caller outside the lock, so a costly rewrite of an
+    // entry does not block the shard's readers.
+    bool replace_if(const KeyType &key, const std::shared_ptr<const ValueType> &expected,
+                    std::shared_ptr<const ValueType> value);
+    // removing entry from the cache
+    bool remove(const KeyType &key);
+    // flush the entire cache, the sketch keeps its history
     void clear();
-};
 
+    // bytes charged for the cached entries, the most there ever were, and the budget (0 = none)
+    size_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+    size_t peak_bytes() const { return peak_bytes_.load(std::memory_order_relaxed); }
+    size_t max_bytes() const;
 
-template <typename KeyType, typename ValueType>
-LRUCache<KeyType, ValueType>::LRUCache(int cap)
-{
-    capacity = cap;
-    current_capacity = 0;
-    // initialize a head and tail
-    head = new Node<KeyType, ValueType>(KeyType(), ValueType());
-    tail = new Node<KeyType, ValueType>(KeyType(), ValueType());
-    head->next = tail;
-    tail->prev = head;
-
-    // initialize lock
-    pthread_mutex_init(&lock, nullptr);
-}
+    // number of cached entries
+    size_t size();
 
-template <typename KeyType, typename ValueType>
-LRUCache<KeyType, ValueType>::~LRUCache()
+    // lookups answered from the cache and lookups that missed
+    size_t hits() const;
+    size_t misses() const;
+};
+
+template <typename KeyType, typename ValueType, typename Hash>
+LRUCache<KeyType, ValueType, Hash>::LRUCache(int cap, size_t num_shards, size_t max_bytes, CostFunction cost,
+                                             AdmissionPolicy admission)
+    : cost_(std::move(cost))
 {
+    if (!cost_)
+        cost_ = [](const KeyType &, const ValueType &) { return sizeof(KeyType) + sizeof(ValueType); };
+
+    size_t capacity = cap > 0 ? static_cast<size_t>(cap) : 1;
+    // every shard holds at least one entry
+    num_shards = std::max<size_t>(1, std::min(num_shards, capacity));
+    size_t per_shard = (capacity + num_shards - 1) / num_shards;
+    size_t bytes_per_shard = max_bytes > 0 ? std::max<size_t>(1, max_bytes / num_shards) : 0;
 
-    // free memory i.e. delete all nodes
-    Node<KeyType, ValueType> *curr = head;
-    while (curr)
+    for (size_t i = 0; i < num_shards; i++)
     {
-        Node<KeyType, ValueType> *next = curr->next;
-        delete curr;
-        curr = next;
+        auto shard = std::make_unique<Shard>();
+        shard->main.capacity = per_shard;
+        shard->main.max_bytes = bytes_per_shard;
+        if (admission == AdmissionPolicy::TINY_LFU)
+        {
+            // the window takes 1% of the shard, at least one entry
+            shard->window.capacity = std::max<size_t>(1, per_shard / 100);
+            shard->main.capacity = std::max<size_t>(1, per_shard - shard->window.capacity);
+            if (bytes_per_shard > 0)
+            {
+                shard->window.max_bytes = std::max<size_t>(1, bytes_per_shard / 100);
+                shard->main.max_bytes = std::max<size_t>(1, bytes_per_shard - shard->window.max_bytes);
+            }
+            shard->sketch = std::make_unique<FrequencySketch>(per_shard);
+        }
+        shards_.push_back(std::move(shard));
     }
-
-    // delete mutex
-    pthread_mutex_destroy(&lock);
 }
 
-template <typename KeyType, typename ValueType>
-void LRUCache<KeyType, ValueType>::addNode(Node<KeyType, ValueType> *node)
+template <typename KeyType, typename ValueType, typename Hash>
+std::shared_ptr<const ValueType> LRUCache<KeyType, ValueType, Hash>::get(const KeyType &key)
 {
-    // node will always be added at the head
-    node->next = head->next;
-    node->prev = head;
-    head->next->prev = node;
-    head->next = node;
-}
+    uint64_t hash = hash_of(key);
+    Shard &shard = shard_for(hash);
+    // readers share the lock, recording the access is a relaxed atomic store
+    pthread_rwlock_rdlock(&shard.lock);
 
-template <typename KeyType, typename ValueType>
-void LRUCache<KeyType, ValueType>::removeNode(Node<KeyType, ValueType> *node)
-{
-    node->prev->next = node->next;
-    node->next->prev = node->prev;
-}
+    if (shard.sketch)
+        shard.sketch->record(hash);
 
-template <typename KeyType, typename ValueType>
-void LRUCache<KeyType, ValueType>::moveToFront(Node<KeyType, ValueType> *node)
-{
-    removeNode(node);
-    addNode(node);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end())
+    {
+        // doesn't exist in cache
+        shard.misses.fetch_add(1, std::memory_order_relaxed);
+        pthread_rwlock_unlock(&shard.lock);
+        return nullptr;
+    }
+
+    Slot &slot = shard.region(it->second).slots[it->second.slot];
+    slot.referenced.store(true, std::memory_order_relaxed);
+    std::shared_ptr<const ValueType> val = slot.value;
+    shard.hits.fetch_add(1, std::memory_order_relaxed);
+
+    pthread_rwlock_unlock(&shard.lock);
+    return val;
 }
 
-// implementing public methods
-template <typename KeyType, typename ValueType>
-std::optional<ValueType> LRUCache<KeyType, ValueType>::get(const KeyType &key)
+template <typename KeyType, typename ValueType, typename Hash>
+void LRUCache<KeyType, ValueType, Hash>::put(const KeyType &key, std::shared_ptr<const ValueType> value)
 {
-    // acquire lock and do all the operations
-    pthread_mutex_lock(&lock);
+    // costs can walk the whole value, so this happens outside the lock
+    size_t cost = cost_(key, *value);
+    uint64_t hash = hash_of(key);
 
-    // if key exists then get it else return false
-    if (cacheMap.find(key) == cacheMap.end())
+    Shard &shard = shard_for(hash);
+    pthread_rwlock_wrlock(&shard.lock);
+    size_t before = shard.bytes();
+    try
     {
-        // doesn't exist in cache
-        pthread_mutex_unlock(&lock);
-        return std::nullopt;
+        shard.store(key, std::move(value), hash, cost);
+    }
+    catch (...)
+    {
+        account(before, shard.bytes());
+        pthread_rwlock_unlock(&shard.lock);
+        throw;
     }
+    account(before, shard.bytes());
+    pthread_rwlock_unlock(&shard.lock);
+}
 
-    Node<KeyType, ValueType> *valueNode = cacheMap[key];
-    // while getting the key, also move it to the front of the list
-    moveToFront(valueNode);
-    ValueType val = valueNode->value;
+template <typename KeyType, typename ValueType, typename Hash>
+std::shared_ptr<const ValueType> LRUCache<KeyType, ValueType, Hash>::peek(const KeyType &key)
+{
+    Shard &shard = shard_for(hash_of(key));
+    pthread_rwlock_rdlock(&shard.lock);
+
+    std::shared_ptr<const ValueType> val;
+    auto it = shard.index.find(key);
+    if (it != shard.index.end())
+        val = shard.region(it->second).slots[it->second.slot].value;
 
-    pthread_mutex_unlock(&lock);
+    pthread_rwlock_unlock(&shard.lock);
     return val;
 }
 
-template <typename KeyType, typename ValueType>
-void LRUCache<KeyType, ValueType>::put(const KeyType &key, const ValueType &value)
+template <typename KeyType, typename ValueType, typename Hash>
+bool LRUCache<KeyType, ValueType, Hash>::replace_if(const KeyType &key, const std::shared_ptr<const ValueType> &expected,
+                                                    std::shared_ptr<const ValueType> value)
 {
-    // acquire lock and do all the operations
-    pthread_mutex_lock(&lock);
+    // like put, the cost is computed outside the lock
+    size_t cost = cost_(key, *value);
+    uint64_t hash = hash_of(key);
+    Shard &shard = shard_for(hash);
+    pthread_rwlock_wrlock(&shard.lock);
 
-    // if key doesn't exists then only append
-    auto it = cacheMap.find(key);
-    if (it == cacheMap.end())
+    auto it = shard.index.find(key);
+    if (it == shard.index.end() || shard.region(it->second).slots[it->second.slot].value != expected)
     {
-        // capacity full
-        if (current_capacity >= capacity)
+        pthread_rwlock_unlock(&shard.lock);
+        return false;
+    }
+
+    size_t before = shard.bytes();
+    try
+    {
+        Region &region = shard.region(it->second);
+        Slot &slot = region.slots[it->second.slot];
+        if (region.max_bytes == 0 || region.bytes - slot.cost + cost <= region.max_bytes)
+        {
+            // still fits, the entry keeps its slot and reference bit
+            region.bytes = region.bytes - slot.cost + cost;
+            slot.cost = cost;
+            slot.value = std::move(value);
+        }
+        else
         {
-            // erase a node first
-            Node<KeyType, ValueType> *last = tail->prev;
-            cacheMap.erase(last->key);
-            removeNode(last);
-            delete last;
-            current_capacity--;
+            shard.store(key, std::move(value), hash, cost);
         }
-        Node<KeyType, ValueType> *new_node = new Node<KeyType, ValueType>(key, value);
-        addNode(new_node);
-        cacheMap[key] = new_node;
-        current_capacity++;
     }
-    else
+    catch (...)
     {
-        // if exists then move to front
-        Node<KeyType, ValueType> *node = it->second;
-        node->value = value;
-        moveToFront(node);
+        account(before, shard.bytes());
+        pthread_rwlock_unlock(&shard.lock);
+        throw;
     }
-    pthread_mutex_unlock(&lock);
+    account(before, shard.bytes());
+    pthread_rwlock_unlock(&shard.lock);
+    return true;
 }
 
-template <typename KeyType, typename ValueType>
-bool LRUCache<KeyType, ValueType>::remove(const KeyType &key)
+template <typename KeyType, typename ValueType, typename Hash>
+bool LRUCache<KeyType, ValueType, Hash>::remove(const KeyType &key)
 {
-    // acquire lock and do all the operations
-    pthread_mutex_lock(&lock);
+    Shard &shard = shard_for(hash_of(key));
+    pthread_rwlock_wrlock(&shard.lock);
 
     // if key exists then only i can remove
-    if (cacheMap.find(key) != cacheMap.end())
+    auto it = shard.index.find(key);
+    if (it == shard.index.end())
     {
+        pthread_rwlock_unlock(&shard.lock);
+        return false;
+    }
+
+    size_t before = shard.bytes();
+    Location location = it->second;
+    shard.index.erase(it);
+    shard.region(location).release(location.slot);
+    account(before, shard.bytes());
 
-        Node<KeyType, ValueType> *node_to_remove = cacheMap[key];
-        removeNode(node_to_remove);
-        cacheMap.erase(key);
-        delete node_to_remove;
-        current_capacity--;
-        pthread_mutex_unlock(&lock);
-        return true;
+    pthread_rwlock_unlock(&shard.lock);
+    return true;
+}
+
+template <typename KeyType, typename ValueType, typename Hash>
+void LRUCache<KeyType, ValueType, Hash>::clear()
+{
+    for (auto &shard : shards_)
+    {
+        pthread_rwlock_wrlock(&shard->lock);
+
+        size_t before = shard->bytes();
+        shard->index.clear();
+        shard->window.reset();
+        shard->main.reset();
+        account(before, 0);
+
+        pthread_rwlock_unlock(&shard->lock);
     }
-    pthread_mutex_unlock(&lock);
-    return false;
 }
 
-template <typename KeyType, typename ValueType>
-void LRUCache<KeyType, ValueType>::clear()
+template <typename KeyType, typename ValueType, typename Hash>
+size_t LRUCache<KeyType, ValueType, Hash>::max_bytes() const
 {
-    pthread_mutex_lock(&lock);
+    size_t total = 0;
+    for (const auto &shard : shards_)
+        total += shard->window.max_bytes + shard->main.max_bytes;
+    return total;
+}
 
-    // Free linked list nodes
-    Node<KeyType, ValueType> *curr = head->next;
-    while (curr != tail)
+template <typename KeyType, typename ValueType, typename Hash>
+size_t LRUCache<KeyType, ValueType, Hash>::size()
+{
+    size_t count = 0;
+    for (auto &shard : shards_)
     {
-        Node<KeyType, ValueType> *next = curr->next;
-        delete curr;
-        curr = next;
+        pthread_rwlock_rdlock(&shard->lock);
+        count += shard->index.size();
+        pthread_rwlock_unlock(&shard->lock);
     }
+    return count;
+}
 
-    // Reset empty list structure
-    head->next = tail;
-    tail->prev = head;
-    cacheMap.clear();
-    current_capacity = 0;
+template <typename KeyType, typename ValueType, typename Hash>
+size_t LRUCache<KeyType, ValueType, Hash>::hits() const
+{
+    size_t count = 0;
+    for (const auto &shard : shards_)
+        count += shard->hits.load(std::memory_order_relaxed);
+    return count;
+}
 
-    pthread_mutex_unlock(&lock);
+template <typename KeyType, typename ValueType, typename Hash>
+size_t LRUCache<KeyType, ValueType, Hash>::misses() const
+{
+    size_t count = 0;
+    for (const auto &shard : shards_)
+        count += shard->misses.load(std::memory_order_relaxed);
+    return count;
 }
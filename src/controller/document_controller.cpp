@@ -2,8 +2,9 @@
 #include "db/document_repository.h"
 #include "db/term_frequency_repository.h"
 #include "db/connection_pool.h"
+#include "db/connection_handle.h"
+#include "utils/logger.h"
 #include <cstring>
-#include <iostream>
 #include <nlohmann/json.hpp>
 #include <chrono> // for timing
 
@@ -11,9 +12,20 @@ using namespace std;
 using json = nlohmann::json;
 using namespace chrono;
 
+// no pooled connection became free in time, the client should retry
+static bool database_busy(struct mg_connection *conn)
+{
+    mg_printf(conn,
+              "HTTP/1.1 503 Service Unavailable\r\n"
+              "Content-Type: application/json\r\n\r\n"
+              "{\"error\": \"Database busy, try again\"}");
+    return true;
+}
+
 // constructor to initialize the connection object
-DocumentController::DocumentController(ConnectionPool *db_pool)
-    : db_pool(db_pool) {}
+DocumentController::DocumentController(ConnectionPool *db_pool, InvertedIndex *index, IngestQueue *ingest,
+                                       AsyncExecutor *async_db)
+    : db_pool(db_pool), index(index), ingest(ingest), async_db(async_db) {}
 
 // handle POST /documents
 bool DocumentController::handlePost(CivetServer *server, struct mg_connection *conn)
@@ -43,36 +55,34 @@ bool DocumentController::handlePost(CivetServer *server, struct mg_connection *c
             total_read += n;
         }
 
-        cout << "Content length is : " << content_len << endl;
+        LOG_DEBUG("Content length is : " << content_len);
         // parse JSON
         json j;
         j = json::parse(body);
         string text = j.value("text", "");
 
-        cout << "text is : " << text << endl;
-
-        // acquiring connection for handling request
-        DBConnection *db_conn = db_pool->acquire();
+        LOG_DEBUG("text is : " << text);
 
-        if (!db_conn)
+        optional<string> doc_id;
+        if (ingest)
         {
-            mg_printf(conn,
-                      "HTTP/1.1 500 Internal Server Error\r\n"
-                      "Content-Type: application/json\r\n\r\n"
-                      "{\"error\": \"Database pool unavailable\"}");
-            return true;
+            // committed together with other concurrent creates, no connection held here
+            doc_id = ingest->submit(text);
         }
+        else
+        {
+            // a connection is taken from the pool for the transaction only
+            ConnectionHandle db_handle(db_pool);
+            DocumentRepository doc_repo(&db_handle);
+            TermFrequencyRepository tf_repo(&db_handle);
+            DocumentService service(&doc_repo, &tf_repo, &db_handle, index);
 
-        // Initialize repositories and service using our db_conn
-        DocumentRepository doc_repo(db_conn);
-        TermFrequencyRepository tf_repo(db_conn);
-        DocumentService service(&doc_repo, &tf_repo, db_conn);
-
-        // Create document - calling service which will handle business logic
-        auto doc_id = service.create_document(text);
+            // Create document - calling service which will handle business logic
+            doc_id = service.create_document(text);
 
-        // release db_pool
-        db_pool->release(db_conn);
+            if (db_handle.unavailable())
+                return database_busy(conn);
+        }
 
         if (!doc_id)
         {
@@ -98,7 +108,7 @@ bool DocumentController::handlePost(CivetServer *server, struct mg_connection *c
     }
     catch (const exception &e)
     {
-        cerr << "Error handling CREATE DOCUMENT: " << e.what() << endl;
+        LOG_ERROR("Error handling CREATE DOCUMENT: " << e.what());
         mg_printf(conn, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n");
         return true;
     }
@@ -122,29 +132,20 @@ bool DocumentController::handleGet(CivetServer* server, mg_connection* conn) {
         // parses the request_uri
         string doc_id = uri.substr(prefix.size());
 
-        // acquiring connection for handling request
-        DBConnection *db_conn = db_pool->acquire();
-
-        if (!db_conn)
-        {
-            mg_printf(conn,
-                      "HTTP/1.1 500 Internal Server Error\r\n"
-                      "Content-Type: application/json\r\n\r\n"
-                      "{\"error\": \"Database pool unavailable\"}");
-            return true;
-        }
-
-        // Initialize service
-        DocumentRepository doc_repo(db_conn);
-        TermFrequencyRepository tf_repo(db_conn);
-        DocumentService service(&doc_repo, &tf_repo, db_conn);
+        // a cached document is returned without touching the pool, a miss goes through the
+        // async executor when there is one
+        ConnectionHandle db_handle(db_pool, async_db);
+        DocumentRepository doc_repo(&db_handle);
+        TermFrequencyRepository tf_repo(&db_handle);
+        DocumentService service(&doc_repo, &tf_repo, &db_handle, index);
 
         // Record start time
         auto start = high_resolution_clock::now();
 
         auto doc_opt = service.get_document_by_id(doc_id);
 
-        db_pool->release(db_conn);
+        if (db_handle.unavailable())
+            return database_busy(conn);
 
         // Record end time
         auto end = high_resolution_clock::now();
@@ -152,7 +153,7 @@ bool DocumentController::handleGet(CivetServer* server, mg_connection* conn) {
         // Compute duration in milliseconds
         auto duration = duration_cast<milliseconds>(end - start);
 
-        cout << "Execution time: " << duration.count() << endl;
+        LOG_DEBUG("Execution time: " << duration.count());
 
         if (!doc_opt)
         {
@@ -182,7 +183,7 @@ bool DocumentController::handleGet(CivetServer* server, mg_connection* conn) {
     }
     catch (const exception &e)
     {
-        cerr << "Error handling SEARCH VIA DOC_ID: " << e.what() << endl;
+        LOG_ERROR("Error handling SEARCH VIA DOC_ID: " << e.what());
         mg_printf(conn, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n");
         return true;
     }
@@ -207,35 +208,25 @@ bool DocumentController::handleDelete(CivetServer* server, mg_connection* conn)
     // parses the request_uri
     string doc_id = uri.substr(prefix.size());
 
-    // acquiring connection for handling request
-    DBConnection *db_conn = db_pool->acquire();
-
-    if (!db_conn)
-    {
-        mg_printf(conn,
-                  "HTTP/1.1 500 Internal Server Error\r\n"
-                  "Content-Type: application/json\r\n\r\n"
-                  "{\"error\": \"Database pool unavailable\"}");
-        return true;
-    }
-
-    // Initialize service
-    DocumentRepository doc_repo(db_conn);
-    TermFrequencyRepository tf_repo(db_conn);
-    DocumentService service(&doc_repo, &tf_repo, db_conn);
+    // a connection is taken from the pool for the transaction only
+    ConnectionHandle db_handle(db_pool);
+    DocumentRepository doc_repo(&db_handle);
+    TermFrequencyRepository tf_repo(&db_handle);
+    DocumentService service(&doc_repo, &tf_repo, &db_handle, index);
 
     bool success = service.delete_document_by_id(doc_id);
 
-    db_pool->release(db_conn);
+    if (db_handle.unavailable())
+        return database_busy(conn);
 
-    cout << "status sent: " << success << endl;
+    LOG_DEBUG("status sent: " << success);
 
     // Convert document to JSON
     json j_response;
     j_response["status"] = success ? "true" : "false";
 
     string response = j_response.dump(); // serialize to string
-    cout << response << endl;
+    LOG_DEBUG(response);
     if (!success) {
         // Document not found or delete failed
         mg_printf(conn,
@@ -256,7 +247,7 @@ bool DocumentController::handleDelete(CivetServer* server, mg_connection* conn)
     }
     catch (const exception &e)
     {
-        cerr << "Error handling DELETING DOCUMENT: " << e.what() << endl;
+        LOG_ERROR("Error handling DELETING DOCUMENT: " << e.what());
         mg_printf(conn, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n");
         return true;
     }
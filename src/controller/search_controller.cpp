@@ -1,9 +1,10 @@
 #include "controller/search_controller.h"
 #include "db/document_repository.h"
 #include "db/connection_pool.h"
+#include "db/connection_handle.h"
 #include "db/term_frequency_repository.h"
+#include "utils/logger.h"
 #include <nlohmann/json.hpp>
-#include <iostream>
 #include <chrono> // for timing
 
 using namespace std;
@@ -11,8 +12,9 @@ using namespace chrono;
 using json = nlohmann::json;
 
 // constructor to initialize the connection object
-SearchController::SearchController(ConnectionPool *db_pool, IDFTable *idf)
-    : db_pool(db_pool), idf_table(idf) {}
+SearchController::SearchController(ConnectionPool *db_pool, IDFTable *idf, InvertedIndex *index, ImpactIndex *impacts,
+                                   AsyncExecutor *async_db)
+    : db_pool(db_pool), idf_table(idf), index(index), impacts(impacts), async_db(async_db) {}
 
 bool SearchController::handleGet(CivetServer *server, struct mg_connection *conn)
 {
@@ -49,30 +51,29 @@ bool SearchController::handleGet(CivetServer *server, struct mg_connection *conn
         // Replace '+' with space (since '+' in URLs encodes spaces)
         replace(query.begin(), query.end(), '+', ' ');
 
-        cout << "Received query: " << query << endl;
+        LOG_DEBUG("Received query: " << query);
 
-        DBConnection *db_conn = db_pool->acquire();
-        if (!db_conn)
-        {
-            mg_printf(conn,
-                      "HTTP/1.1 500 Internal Server Error\r\n"
-                      "Content-Type: application/json\r\n\r\n"
-                      "{\"error\": \"Database pool unavailable\"}");
-            return true;
-        }
-
-        // Initialize repositories and service using our db_conn
-        DocumentRepository doc_repo(db_conn);
-        TermFrequencyRepository tf_repo(db_conn);
-        SearchService search_service(&doc_repo, &tf_repo, idf_table);
+        // a connection is only taken from the pool if the search misses the caches, and
+        // only for the duration of each query (never, with the async executor)
+        ConnectionHandle db_handle(db_pool, async_db);
+        DocumentRepository doc_repo(&db_handle);
+        TermFrequencyRepository tf_repo(&db_handle);
+        SearchService search_service(&doc_repo, &tf_repo, idf_table, index, impacts);
 
         // Record start time
         auto start = high_resolution_clock::now();
 
         auto results = search_service.search(query);
 
-        // releasing the object
-        db_pool->release(db_conn);
+        // results would be missing what the db could not be asked for
+        if (db_handle.unavailable())
+        {
+            mg_printf(conn,
+                      "HTTP/1.1 503 Service Unavailable\r\n"
+                      "Content-Type: application/json\r\n\r\n"
+                      "{\"error\": \"Database busy, try again\"}");
+            return true;
+        }
 
         // Record end time
         auto end = high_resolution_clock::now();
@@ -80,7 +81,7 @@ bool SearchController::handleGet(CivetServer *server, struct mg_connection *conn
         // Compute duration in milliseconds
         auto duration = duration_cast<milliseconds>(end - start);
 
-        cout << "Execution time: " << duration.count() << endl;
+        LOG_DEBUG("Execution time: " << duration.count());
 
         json j_resp;
 
@@ -103,12 +104,12 @@ bool SearchController::handleGet(CivetServer *server, struct mg_connection *conn
             }
             j_resp["results"] = arr;
             j_resp["message"] = "Documents retrieved successfully";
-            cout << j_resp["message"] << endl;
+            LOG_DEBUG(j_resp["message"]);
         }
 
         string response_str = j_resp.dump();
 
-        cout << response_str << endl;
+        LOG_DEBUG(response_str);
 
         mg_printf(conn,
                   "HTTP/1.1 200 OK\r\n"
@@ -121,7 +122,7 @@ bool SearchController::handleGet(CivetServer *server, struct mg_connection *conn
     }
     catch (const exception &e)
     {
-        cerr << "Error handling SEARCH VIA QUERY: " << e.what() << endl;
+        LOG_ERROR("Error handling SEARCH VIA QUERY: " << e.what());
         mg_printf(conn, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n");
         return true;
     }
@@ -0,0 +1,382 @@
+#include "db/async_executor.h"
+#include "utils/logger.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+    // epoll tag of a worker's eventfd, connections are tagged with their index
+    const uint64_t WAKE = UINT64_MAX;
+
+    // how often a broken connection is tried again
+    const auto RETRY_INTERVAL = chrono::seconds(1);
+}
+
+AsyncExecutor::AsyncExecutor(int threads, int connections_per_thread, const string &db_name,
+                             const string &user, const string &password)
+    : db_name(db_name), user(user), password(password)
+{
+    size_t running = 0;
+    try
+    {
+        // every connection is opened before any thread runs
+        for (int t = 0; t < threads; t++)
+        {
+            workers.push_back(make_unique<Worker>());
+            Worker &worker = *workers.back();
+            worker.executor = this;
+            pthread_mutex_init(&worker.lock, nullptr);
+
+            worker.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+            worker.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (worker.epoll_fd < 0 || worker.wake_fd < 0)
+                throw runtime_error("Unable to create async executor event loop");
+
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = WAKE;
+            if (epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, worker.wake_fd, &event) != 0)
+                throw runtime_error("Unable to create async executor event loop");
+
+            worker.connections.resize(connections_per_thread);
+            for (size_t i = 0; i < worker.connections.size(); i++)
+            {
+                if (!connect(worker, i))
+                    throw runtime_error("DB connection failed");
+            }
+        }
+
+        for (auto &worker : workers)
+        {
+            if (pthread_create(&worker->thread, nullptr, io_thread, worker.get()) != 0)
+                throw runtime_error("Unable to start async executor thread");
+            running++;
+        }
+
+        LOG_INFO("Async executor started: " << threads << " I/O threads, " << connections_per_thread
+              << " connections each");
+    }
+    catch (...)
+    {
+        // cleanup anything created so far, rethrow so caller knows this failed
+        shutdown(running);
+        throw;
+    }
+}
+
+AsyncExecutor::~AsyncExecutor()
+{
+    shutdown(workers.size());
+}
+
+void AsyncExecutor::shutdown(size_t running)
+{
+    stopping = true;
+    for (size_t i = 0; i < running; i++)
+    {
+        uint64_t one = 1;
+        if (::write(workers[i]->wake_fd, &one, sizeof(one)) < 0)
+            LOG_ERROR("Unable to wake async executor thread: " << strerror(errno));
+        pthread_join(workers[i]->thread, nullptr);
+    }
+
+    for (auto &worker : workers)
+    {
+        pthread_mutex_lock(&worker->lock);
+        deque<Query> queued;
+        queued.swap(worker->queue);
+        pthread_mutex_unlock(&worker->lock);
+        for (auto &query : queued)
+            complete(query, nullptr);
+
+        for (auto &connection : worker->connections)
+        {
+            if (connection.db)
+                drop(*worker, connection);
+        }
+
+        if (worker->wake_fd >= 0)
+            ::close(worker->wake_fd);
+        if (worker->epoll_fd >= 0)
+            ::close(worker->epoll_fd);
+        pthread_mutex_destroy(&worker->lock);
+    }
+    workers.clear();
+}
+
+void AsyncExecutor::submit(const Statement &statement, vector<string> params, bool binary_result,
+                           Callback on_result)
+{
+    if (stopping || workers.empty())
+    {
+        on_result(nullptr);
+        return;
+    }
+
+    Worker &worker = *workers[next_worker++ % workers.size()];
+    pthread_mutex_lock(&worker.lock);
+    worker.queue.push_back({&statement, move(params), binary_result, move(on_result)});
+    pthread_mutex_unlock(&worker.lock);
+
+    // the eventfd counts, any number of submits before the thread looks is one wakeup
+    uint64_t one = 1;
+    if (::write(worker.wake_fd, &one, sizeof(one)) < 0)
+        LOG_ERROR("Unable to wake async executor thread: " << strerror(errno));
+}
+
+void *AsyncExecutor::io_thread(void *arg)
+{
+    Worker *worker = static_cast<Worker *>(arg);
+    worker->executor->run(*worker);
+    return nullptr;
+}
+
+void AsyncExecutor::run(Worker &worker)
+{
+    epoll_event events[32];
+    while (!stopping)
+    {
+        // wakes up at least once a second to reopen broken connections
+        int n = epoll_wait(worker.epoll_fd, events, 32, 1000);
+        if (n < 0 && errno != EINTR)
+        {
+            LOG_ERROR("Async executor epoll_wait failed: " << strerror(errno));
+            break;
+        }
+
+        for (int e = 0; e < n; e++)
+        {
+            if (events[e].data.u64 == WAKE)
+            {
+                uint64_t count;
+                if (::read(worker.wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+                    LOG_ERROR("Async executor wakeup failed: " << strerror(errno));
+
+                deque<Query> queued;
+                pthread_mutex_lock(&worker.lock);
+                queued.swap(worker.queue);
+                pthread_mutex_unlock(&worker.lock);
+
+                for (auto &query : queued)
+                    dispatch(worker, query);
+                continue;
+            }
+
+            Connection &connection = worker.connections[events[e].data.u64];
+            // dropped earlier in this round
+            if (!connection.db)
+                continue;
+            if (events[e].events & EPOLLOUT)
+                flush(worker, connection);
+            if (connection.db && (events[e].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+                receive(worker, connection);
+        }
+
+        // reconnecting blocks this thread, the retry interval keeps a down database from
+        // stalling it on every round
+        auto t = chrono::steady_clock::now();
+        for (size_t i = 0; i < worker.connections.size(); i++)
+        {
+            Connection &connection = worker.connections[i];
+            if (!connection.db && t >= connection.retry_at && !connect(worker, i))
+                connection.retry_at = t + RETRY_INTERVAL;
+        }
+    }
+}
+
+bool AsyncExecutor::connect(Worker &worker, size_t i)
+{
+    // the constructor connects and prepares the statements in blocking mode, after that
+    // nothing on this connection waits for the server
+    DBConnection *db = new DBConnection(db_name, user, password);
+    if (!db->is_connected())
+    {
+        delete db;
+        return false;
+    }
+
+    PGconn *conn = db->get_conn();
+    if (PQsetnonblocking(conn, 1) != 0 || PQenterPipelineMode(conn) != 1)
+    {
+        LOG_ERROR("Unable to switch connection to pipeline mode: " << PQerrorMessage(conn));
+        delete db;
+        return false;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = i;
+    if (epoll_ctl(worker.epoll_fd, EPOLL_CTL_ADD, PQsocket(conn), &event) != 0)
+    {
+        LOG_ERROR("Unable to watch connection socket: " << strerror(errno));
+        delete db;
+        return false;
+    }
+
+    Connection &connection = worker.connections[i];
+    connection.db = db;
+    connection.socket = PQsocket(conn);
+    connection.writing = false;
+    return true;
+}
+
+void AsyncExecutor::drop(Worker &worker, Connection &connection)
+{
+    for (auto &query : connection.in_flight)
+        complete(query, nullptr);
+    connection.in_flight.clear();
+
+    if (connection.result)
+    {
+        PQclear(connection.result);
+        connection.result = nullptr;
+    }
+
+    epoll_ctl(worker.epoll_fd, EPOLL_CTL_DEL, connection.socket, nullptr);
+    delete connection.db;
+    connection.db = nullptr;
+    connection.socket = -1;
+    connection.writing = false;
+    connection.retry_at = chrono::steady_clock::now() + RETRY_INTERVAL;
+}
+
+void AsyncExecutor::dispatch(Worker &worker, Query &query)
+{
+    Connection *target = nullptr;
+    for (auto &connection : worker.connections)
+    {
+        if (connection.db && (!target || connection.in_flight.size() < target->in_flight.size()))
+            target = &connection;
+    }
+
+    // every connection of this thread is down
+    if (!target)
+    {
+        complete(query, nullptr);
+        return;
+    }
+
+    vector<const char *> values;
+    values.reserve(query.params.size());
+    for (const auto &param : query.params)
+        values.push_back(param.c_str());
+
+    PGconn *conn = target->db->get_conn();
+    if (PQsendQueryPrepared(conn, query.statement->name, query.statement->n_params, values.data(), nullptr,
+                            nullptr, query.binary_result ? 1 : 0) != 1)
+    {
+        LOG_ERROR("Failed to send query " << query.statement->name << ": " << PQerrorMessage(conn));
+        complete(query, nullptr);
+        if (PQstatus(conn) == CONNECTION_BAD)
+            drop(worker, *target);
+        return;
+    }
+    target->in_flight.push_back(move(query));
+
+    // a sync per query: it commits on its own and an error does not abort the queries behind it
+    if (PQpipelineSync(conn) != 1)
+    {
+        LOG_ERROR("Pipeline sync failed: " << PQerrorMessage(conn));
+        drop(worker, *target);
+        return;
+    }
+    flush(worker, *target);
+}
+
+void AsyncExecutor::flush(Worker &worker, Connection &connection)
+{
+    int pending = PQflush(connection.db->get_conn());
+    if (pending < 0)
+    {
+        LOG_ERROR("Failed to send queries: " << PQerrorMessage(connection.db->get_conn()));
+        drop(worker, connection);
+        return;
+    }
+
+    // the socket is full, write the rest once it drains
+    bool writing = pending == 1;
+    if (writing != connection.writing)
+    {
+        epoll_event event{};
+        event.events = EPOLLIN | (writing ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        event.data.u64 = &connection - worker.connections.data();
+        epoll_ctl(worker.epoll_fd, EPOLL_CTL_MOD, connection.socket, &event);
+        connection.writing = writing;
+    }
+}
+
+void AsyncExecutor::receive(Worker &worker, Connection &connection)
+{
+    PGconn *conn = connection.db->get_conn();
+    if (PQconsumeInput(conn) != 1)
+    {
+        LOG_ERROR("Async connection lost: " << PQerrorMessage(conn));
+        drop(worker, connection);
+        return;
+    }
+
+    // each query yields its result followed by a null, then its sync its own result.
+    // PQisBusy means the rest has not arrived yet, epoll says when it does
+    while (!PQisBusy(conn))
+    {
+        PGresult *res = PQgetResult(conn);
+        if (!res)
+        {
+            // a null without a result means nothing is left to read
+            if (connection.in_flight.empty() || !connection.result)
+                break;
+
+            Query query = move(connection.in_flight.front());
+            connection.in_flight.pop_front();
+            PGresult *result = connection.result;
+            connection.result = nullptr;
+
+            ExecStatusType status = PQresultStatus(result);
+            if (status == PGRES_TUPLES_OK || status == PGRES_COMMAND_OK)
+            {
+                complete(query, result);
+            }
+            else
+            {
+                LOG_ERROR("Query " << query.statement->name << " failed: " << PQresultErrorMessage(result));
+                complete(query, nullptr);
+            }
+            PQclear(result);
+            continue;
+        }
+
+        if (PQresultStatus(res) == PGRES_PIPELINE_SYNC || connection.in_flight.empty())
+        {
+            PQclear(res);
+            continue;
+        }
+
+        if (connection.result)
+            PQclear(connection.result);
+        connection.result = res;
+    }
+
+    if (PQstatus(conn) == CONNECTION_BAD)
+    {
+        LOG_ERROR("Async connection lost: " << PQerrorMessage(conn));
+        drop(worker, connection);
+    }
+}
+
+void AsyncExecutor::complete(Query &query, const PGresult *res)
+{
+    try
+    {
+        query.on_result(res);
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Exception in async query callback: " << e.what());
+    }
+}
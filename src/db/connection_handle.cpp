@@ -0,0 +1,96 @@
+#include "db/connection_handle.h"
+#include <iostream>
+
+using namespace std;
+
+ConnectionHandle::ConnectionHandle(ConnectionPool *pool, AsyncExecutor *executor) : pool(pool), executor(executor) {}
+
+ConnectionHandle::ConnectionHandle(DBConnection *conn) : conn(conn) {}
+
+ConnectionHandle::~ConnectionHandle()
+{
+    // an exception may have left a transaction open, the pool rolls it back on release
+    pinned = false;
+    leases = 0;
+    release_if_unused();
+}
+
+DBConnection *ConnectionHandle::lease()
+{
+    if (!conn && pool)
+    {
+        conn = pool->acquire();
+        if (!conn)
+        {
+            failed_acquire = true;
+            return nullptr;
+        }
+    }
+    if (conn)
+        leases++;
+    return conn;
+}
+
+void ConnectionHandle::unlease()
+{
+    leases--;
+    release_if_unused();
+}
+
+void ConnectionHandle::release_if_unused()
+{
+    // fixed connections are never handed back
+    if (pool && conn && leases == 0 && !pinned)
+    {
+        pool->release(conn);
+        conn = nullptr;
+    }
+}
+
+bool ConnectionHandle::begin_transaction()
+{
+    Lease db(this);
+    if (!db || !db->begin_transaction())
+        return false;
+    pinned = true;
+    return true;
+}
+
+bool ConnectionHandle::commit()
+{
+    if (!conn)
+        return false;
+    bool ok = conn->commit();
+    pinned = false;
+    release_if_unused();
+    return ok;
+}
+
+bool ConnectionHandle::rollback()
+{
+    if (!conn)
+        return false;
+    bool ok = conn->rollback();
+    pinned = false;
+    release_if_unused();
+    return ok;
+}
+
+bool ConnectionHandle::begin_pipeline()
+{
+    Lease db(this);
+    if (!db || !db->begin_pipeline())
+        return false;
+    pinned = true;
+    return true;
+}
+
+bool ConnectionHandle::end_pipeline()
+{
+    if (!conn)
+        return false;
+    bool ok = conn->end_pipeline();
+    pinned = false;
+    release_if_unused();
+    return ok;
+}
@@ -1,46 +1,94 @@
 #include "db/connection_pool.h"
-#include <iostream>
+#include "utils/logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <vector>
 
 using namespace std;
 
-ConnectionPool::ConnectionPool(int poolSize,const std::string &db_name,
+namespace
+{
+    timespec now()
+    {
+        timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return t;
+    }
+
+    timespec plus_ms(timespec t, long ms)
+    {
+        t.tv_sec += ms / 1000;
+        t.tv_nsec += (ms % 1000) * 1000000;
+        if (t.tv_nsec >= 1000000000)
+        {
+            t.tv_sec++;
+            t.tv_nsec -= 1000000000;
+        }
+        return t;
+    }
+
+    long elapsed_ms(const timespec &since, const timespec &until)
+    {
+        return (until.tv_sec - since.tv_sec) * 1000L + (until.tv_nsec - since.tv_nsec) / 1000000;
+    }
+
+    uint64_t elapsed_us(const timespec &since)
+    {
+        timespec t = now();
+        return (t.tv_sec - since.tv_sec) * 1000000L + (t.tv_nsec - since.tv_nsec) / 1000;
+    }
+}
+
+ConnectionPool::ConnectionPool(int min_size, int max_size, const std::string &db_name,
                                const std::string &user,
-                               const std::string &password)
-    : size(poolSize)
+                               const std::string &password,
+                               long acquire_timeout_ms,
+                               long idle_timeout_ms,
+                               long health_check_ms)
+    : min_size(min_size), max_size(max_size < min_size ? min_size : max_size),
+      acquire_timeout_ms(acquire_timeout_ms), idle_timeout_ms(idle_timeout_ms),
+      health_check_ms(health_check_ms), db_name(db_name), user(user), password(password)
 {
     pthread_mutex_init(&lock, nullptr);
-    pthread_cond_init(&cond, nullptr);
+
+    // acquire timeouts are measured against the monotonic clock
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&cond, &attr);
+    pthread_cond_init(&health_cond, &attr);
+    pthread_condattr_destroy(&attr);
 
     try
     {
-        for (size_t i = 0; i < poolSize; i++)
+        for (int i = 0; i < min_size; i++)
         {
-            DBConnection *conn = new DBConnection(db_name,user,password);
+            DBConnection *conn = connect();
 
-            if (!conn->is_connected())
-            {
-                // failed → cleanup and throw
-                delete conn;
+            // the server can't start without its minimum
+            if (!conn)
                 throw std::runtime_error("DB connection failed");
-            }
 
-            pool.push(conn);
+            idle.push_back({conn, now()});
+            open++;
         }
 
-        cout << "Pool of database objects created: " << poolSize << endl;
+        if (pthread_create(&health_thread, nullptr, health_check_thread, this) != 0)
+            throw std::runtime_error("Unable to start connection health check thread");
+
+        LOG_INFO("Pool of database objects created: " << min_size << " (up to " << this->max_size << ")");
     }
     catch (const std::exception &e)
     {
         // cleanup anything created so far
-        while (!pool.empty())
-        {
-            DBConnection *c = pool.front();
-            pool.pop();
-            delete c;
-        }
+        for (auto &entry : idle)
+            delete entry.conn;
+        idle.clear();
 
         pthread_mutex_destroy(&lock);
         pthread_cond_destroy(&cond);
+        pthread_cond_destroy(&health_cond);
 
         // rethrow so caller knows this failed
         throw;
@@ -49,38 +97,285 @@ ConnectionPool::ConnectionPool(int poolSize,const std::string &db_name,
 
 ConnectionPool::~ConnectionPool()
 {
-    while (!pool.empty())
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_signal(&health_cond);
+    pthread_mutex_unlock(&lock);
+    pthread_join(health_thread, nullptr);
+
+    for (auto &entry : idle)
+        delete entry.conn;
+    idle.clear();
+
+    pthread_mutex_destroy(&lock);
+    pthread_cond_destroy(&cond);
+    pthread_cond_destroy(&health_cond);
+}
+
+DBConnection *ConnectionPool::connect()
+{
+    DBConnection *conn = new DBConnection(db_name, user, password);
+    if (!conn->is_connected())
     {
-        DBConnection *conn = pool.front();
-        pool.pop();
         delete conn;
+        return nullptr;
     }
+    return conn;
+}
 
-    pthread_mutex_destroy(&lock);
-    pthread_cond_destroy(&cond);
+bool ConnectionPool::heal(DBConnection *conn)
+{
+    if (conn->is_connected())
+        return true;
+    if (!conn->reconnect())
+        return false;
+    reconnects++;
+    return true;
+}
+
+void ConnectionPool::discard(DBConnection *conn)
+{
+    delete conn;
+    open--;
+    // a waiter may now open a replacement
+    pthread_cond_signal(&cond);
 }
 
 DBConnection *ConnectionPool::acquire()
 {
-    pthread_mutex_lock(&lock);
+    timespec start = now();
+    timespec deadline = plus_ms(start, acquire_timeout_ms);
 
-    while (pool.empty())
+    pthread_mutex_lock(&lock);
+    while (true)
     {
-        pthread_cond_wait(&cond, &lock);
+        if (!idle.empty())
+        {
+            DBConnection *conn = idle.back().conn;
+            idle.pop_back();
+
+            // a connection that broke while idle is not reconnected here, that blocks like a
+            // connect: it is dropped and replaced like any missing connection
+            if (!conn->is_connected())
+            {
+                discard(conn);
+                continue;
+            }
+            pthread_mutex_unlock(&lock);
+
+            uint64_t waited = elapsed_us(start);
+            acquires++;
+            wait_us += waited;
+            uint64_t max_wait = max_wait_us.load();
+            while (waited > max_wait && !max_wait_us.compare_exchange_weak(max_wait, waited))
+            {
+            }
+            return conn;
+        }
+
+        // nothing idle: the health check thread opens another one if allowed, the wait
+        // below stays bounded by the deadline however long that connect takes
+        if (open < max_size && !grow_requested)
+        {
+            grow_requested = true;
+            pthread_cond_signal(&health_cond);
+        }
+
+        waiting++;
+        int rc = pthread_cond_timedwait(&cond, &lock, &deadline);
+        waiting--;
+        if (rc == ETIMEDOUT && idle.empty())
+        {
+            pthread_mutex_unlock(&lock);
+            timeouts++;
+            LOG_WARN("No database connection available within " << acquire_timeout_ms << " ms");
+            return nullptr;
+        }
     }
+}
+
+void ConnectionPool::release(DBConnection *conn)
+{
+    if (!conn)
+        return;
 
-    DBConnection *conn = pool.front();
-    pool.pop();
+    // a request that failed mid transaction must not hand its open transaction on
+    if (conn->is_connected() && PQtransactionStatus(conn->get_conn()) != PQTRANS_IDLE)
+        conn->rollback();
 
+    bool usable = heal(conn);
+
+    pthread_mutex_lock(&lock);
+    if (usable)
+    {
+        idle.push_back({conn, now()});
+        pthread_cond_signal(&cond);
+    }
+    else
+    {
+        // dead connections never go back into the pool
+        discard(conn);
+    }
     pthread_mutex_unlock(&lock);
-    return conn;
 }
 
-void ConnectionPool::release(DBConnection *conn)
+void ConnectionPool::check_idle()
 {
     pthread_mutex_lock(&lock);
-    pool.push(conn);
-    cout << "Connection released!!!!!!!" << endl;
-    pthread_cond_signal(&cond);
+    timespec t = now();
+    vector<DBConnection *> reaped;
+    while (!idle.empty() && open - reaped.size() > min_size && elapsed_ms(idle.front().since, t) >= idle_timeout_ms)
+    {
+        reaped.push_back(idle.front().conn);
+        idle.pop_front();
+    }
+    for (DBConnection *conn : reaped)
+        discard(conn);
+    pthread_mutex_unlock(&lock);
+
+    // Connections released within the last interval were healthy then (release heals them),
+    // only older ones are pinged. One at a time and outside the lock: a ping can block for
+    // long while the database is down, the other idle connections stay available meanwhile.
+    vector<DBConnection *> checked;
+    while (true)
+    {
+        pthread_mutex_lock(&lock);
+        auto it = idle.begin();
+        while (it != idle.end() && (elapsed_ms(it->since, t) < health_check_ms ||
+                                    find(checked.begin(), checked.end(), it->conn) != checked.end()))
+            ++it;
+        if (it == idle.end() || stopping)
+        {
+            pthread_mutex_unlock(&lock);
+            break;
+        }
+        Idle entry = *it;
+        size_t position = it - idle.begin();
+        idle.erase(it);
+        pthread_mutex_unlock(&lock);
+
+        bool healthy = entry.conn->ping() || heal(entry.conn);
+
+        pthread_mutex_lock(&lock);
+        if (healthy)
+        {
+            // back where it was, keeping the idle order
+            checked.push_back(entry.conn);
+            idle.insert(idle.begin() + min(position, idle.size()), entry);
+            pthread_cond_signal(&cond);
+        }
+        else
+        {
+            discard(entry.conn);
+        }
+        pthread_mutex_unlock(&lock);
+    }
+
+    // top back up to the minimum after connections were lost
+    while (true)
+    {
+        pthread_mutex_lock(&lock);
+        bool below = open < min_size && !stopping;
+        if (below)
+            open++;
+        pthread_mutex_unlock(&lock);
+        if (!below)
+            break;
+
+        DBConnection *conn = connect();
+        pthread_mutex_lock(&lock);
+        if (conn)
+        {
+            idle.push_back({conn, now()});
+            pthread_cond_signal(&cond);
+        }
+        else
+        {
+            open--;
+        }
+        pthread_mutex_unlock(&lock);
+        // database still down, retried on the next check
+        if (!conn)
+            break;
+    }
+}
+
+void ConnectionPool::grow()
+{
+    while (true)
+    {
+        pthread_mutex_lock(&lock);
+        bool needed = waiting > idle.size() && open < max_size && !stopping;
+        if (needed)
+            open++;
+        pthread_mutex_unlock(&lock);
+        if (!needed)
+            break;
+
+        DBConnection *conn = connect();
+        pthread_mutex_lock(&lock);
+        if (conn)
+        {
+            idle.push_back({conn, now()});
+            pthread_cond_signal(&cond);
+        }
+        else
+        {
+            open--;
+        }
+        pthread_mutex_unlock(&lock);
+        // database unreachable, the next acquire that finds nothing idle asks again
+        if (!conn)
+            break;
+    }
+}
+
+void ConnectionPool::logStats()
+{
+    pthread_mutex_lock(&lock);
+    size_t total = open, available = idle.size();
     pthread_mutex_unlock(&lock);
+
+    uint64_t count = acquires.load();
+    LOG_INFO("Connection pool: " << total << " open, " << total - available << " in use, " << available
+          << " idle, " << count << " acquires, " << timeouts.load() << " timeouts, average wait "
+          << (count ? wait_us.load() / 1000.0 / count : 0.0) << " ms (max " << max_wait_us.load() / 1000.0
+          << " ms), " << reconnects.load() << " reconnects");
+}
+
+void *ConnectionPool::health_check_thread(void *arg)
+{
+    ConnectionPool *pool = static_cast<ConnectionPool *>(arg);
+    timespec next = plus_ms(now(), pool->health_check_ms);
+    while (true)
+    {
+        // grow requests wake it early, the checks keep their own interval
+        pthread_mutex_lock(&pool->lock);
+        int rc = 0;
+        while (!pool->stopping && !pool->grow_requested && rc != ETIMEDOUT)
+            rc = pthread_cond_timedwait(&pool->health_cond, &pool->lock, &next);
+        bool stop = pool->stopping;
+        bool grow = pool->grow_requested;
+        pool->grow_requested = false;
+        pthread_mutex_unlock(&pool->lock);
+        if (stop)
+            break;
+
+        try
+        {
+            if (grow)
+                pool->grow();
+            if (elapsed_ms(next, now()) >= 0)
+            {
+                pool->check_idle();
+                pool->logStats();
+                next = plus_ms(now(), pool->health_check_ms);
+            }
+        }
+        catch (const exception &e)
+        {
+            LOG_ERROR("Exception in connection health check: " << e.what());
+        }
+    }
+    return nullptr;
 }
@@ -1,13 +1,15 @@
 #include "db/document_repository.h"
-#include <iostream>
+#include "utils/logger.h"
 #include <optional>
 #include <vector>
+#include <random>
+#include <cstdio>
 
 using namespace std;
 
 // constructor initialization
-DocumentRepository::DocumentRepository(DBConnection* db_conn) {
-    db = db_conn;
+DocumentRepository::DocumentRepository(ConnectionHandle* db_handle) {
+    handle = db_handle;
 }
 
 // CREATE
@@ -15,101 +17,214 @@ optional<string> DocumentRepository::create_document(const string &text)
 {
     try
     {
-        if (!db || !db->is_connected())
+        ConnectionHandle::Lease db(handle);
+        if (!db)
             return nullopt;
 
-        const char *paramValues[1];
-        paramValues[0] = text.c_str();
-
-        string query = "INSERT INTO documents (document_text) VALUES ($1) RETURNING doc_id;";
-
-        PGresult *res = PQexecParams(db->get_conn(),
-                                     query.c_str(),
-                                     1,       // number of parameters
-                                     nullptr, // param types
-                                     paramValues,
-                                     nullptr, // param lengths
-                                     nullptr, // param formats
-                                     0);      // text format
-
-        if (!res || PQresultStatus(res) != PGRES_TUPLES_OK)
+        const char *paramValues[1] = {text.c_str()};
+        PGresult *res = db->execute_prepared(Statements::INSERT_DOCUMENT, paramValues, true);
+        if (!res)
         {
-            if (res)
-                PQclear(res);
-            cerr << "Failed to insert document: " << PQerrorMessage(db->get_conn()) << endl;
+            LOG_ERROR("Failed to insert document");
             return nullopt;
         }
 
-        string doc_id = PQgetvalue(res, 0, 0);
+        string doc_id = DBConnection::uuid_value(res, 0, 0);
         PQclear(res);
         return doc_id;
     }
     catch (const exception &e)
     {
-        cerr << "Error occured at create document in repo " << e.what() << endl;
+        LOG_ERROR("Error occured at create document in repo " << e.what());
         return nullopt;
     }
 }
 
-// READ by ID
-optional<Document> DocumentRepository::get_document_by_id(const string &doc_id)
+// random (version 4) uuid, what uuid_generate_v4() would have assigned
+static string generate_uuid()
+{
+    thread_local mt19937_64 rng(random_device{}());
+    uint64_t high = rng(), low = rng();
+    high = (high & 0xFFFFFFFFFFFF0FFFULL) | 0x0000000000004000ULL; // version 4
+    low = (low & 0x3FFFFFFFFFFFFFFFULL) | 0x8000000000000000ULL;   // RFC 4122 variant
+
+    char uuid[37];
+    snprintf(uuid, sizeof(uuid), "%08x-%04x-%04x-%04x-%012llx",
+             static_cast<unsigned>(high >> 32), static_cast<unsigned>((high >> 16) & 0xFFFF),
+             static_cast<unsigned>(high & 0xFFFF), static_cast<unsigned>(low >> 48),
+             static_cast<unsigned long long>(low & 0xFFFFFFFFFFFFULL));
+    return uuid;
+}
+
+// CREATE inside a pipeline
+optional<string> DocumentRepository::send_create_document(const string &text)
 {
     try
     {
-        if (!db || !db->is_connected())
+        ConnectionHandle::Lease db(handle);
+        if (!db)
             return nullopt;
 
-        string query = "SELECT doc_id, document_text, created_at FROM documents WHERE doc_id = '" + doc_id + "';";
-        PGresult *res = db->execute_query(query);
-        if (!res)
+        // no result can be read before the pipeline ends, so the doc_id is assigned here
+        // and the term frequency rows queued behind this insert can already use it
+        string doc_id = generate_uuid();
+        const char *paramValues[2] = {doc_id.c_str(), text.c_str()};
+
+        if (!db->send_query(Statements::INSERT_DOCUMENT_WITH_ID, paramValues))
             return nullopt;
+        return doc_id;
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Error occured at send_create_document in repo " << e.what());
+        return nullopt;
+    }
+}
 
-        if (PQntuples(res) == 0)
-        {
-            PQclear(res);
+// CREATE several documents with a single COPY
+optional<vector<string>> DocumentRepository::create_documents_bulk(const vector<string> &texts)
+{
+    try
+    {
+        if (texts.empty())
+            return nullopt;
+        ConnectionHandle::Lease db(handle);
+        if (!db)
             return nullopt;
+
+        // COPY returns no rows, so the doc_ids are assigned here
+        vector<string> doc_ids;
+        string data;
+        for (const auto &text : texts)
+        {
+            doc_ids.push_back(generate_uuid());
+            data += doc_ids.back();
+            data += '\t';
+            DBConnection::append_copy_field(data, text);
+            data += '\n';
         }
 
-        Document doc;
-        doc.doc_id = PQgetvalue(res, 0, 0);
-        doc.document_text = PQgetvalue(res, 0, 1);
-        doc.created_at = PQgetvalue(res, 0, 2);
+        if (!db->copy_in("COPY documents (doc_id, document_text) FROM STDIN;", data))
+            return nullopt;
+        return doc_ids;
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Error occured at create_documents_bulk in repo " << e.what());
+        return nullopt;
+    }
+}
 
-        PQclear(res);
-        return doc;
+// READ by ID
+optional<Document> DocumentRepository::get_document_by_id(const string &doc_id)
+{
+    try
+    {
+        return fetch_document_by_id(doc_id).get();
     }
     catch (const exception &e)
     {
-        cerr << "Error occured at get_document_by_id in repo " << e.what() << endl;
+        LOG_ERROR("Error occured at get_document_by_id in repo " << e.what());
         return nullopt;
     }
 }
 
+future<optional<Document>> DocumentRepository::fetch_document_by_id(const string &doc_id)
+{
+    return handle->query<optional<Document>>(
+        Statements::GET_DOCUMENT, {doc_id}, true,
+        [](const PGresult *res) -> optional<Document>
+        {
+            if (!res || PQntuples(res) == 0)
+                return nullopt;
+
+            Document doc;
+            doc.doc_id = DBConnection::uuid_value(res, 0, 0);
+            doc.document_text = DBConnection::text_value(res, 0, 1);
+            doc.created_at = DBConnection::text_value(res, 0, 2);
+            return doc;
+        });
+}
+
+// READ several by ID
+vector<Document> DocumentRepository::get_documents_by_ids(const vector<string> &doc_ids)
+{
+    try
+    {
+        return fetch_documents_by_ids(doc_ids).get();
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Error occured at get_documents_by_ids in repo " << e.what());
+        return {};
+    }
+}
+
+future<vector<Document>> DocumentRepository::fetch_documents_by_ids(const vector<string> &doc_ids)
+{
+    if (doc_ids.empty())
+    {
+        promise<vector<Document>> none;
+        none.set_value({});
+        return none.get_future();
+    }
+
+    // uuid[] literal, uuids need no quoting
+    string id_array = "{";
+    for (size_t i = 0; i < doc_ids.size(); ++i)
+    {
+        if (i > 0)
+            id_array += ",";
+        id_array += doc_ids[i];
+    }
+    id_array += "}";
+
+    return handle->query<vector<Document>>(
+        Statements::GET_DOCUMENTS, {move(id_array)}, true,
+        [](const PGresult *res)
+        {
+            vector<Document> docs;
+            if (!res)
+                return docs;
+
+            int n = PQntuples(res);
+            docs.reserve(n);
+            for (int i = 0; i < n; ++i)
+            {
+                docs.push_back({DBConnection::uuid_value(res, i, 0),
+                                DBConnection::text_value(res, i, 1),
+                                DBConnection::text_value(res, i, 2)});
+            }
+            return docs;
+        });
+}
+
 // READ all
 vector<Document> DocumentRepository::get_all_documents()
 {
     vector<Document> docs;
     try
     {
-        if (!db || !db->is_connected())
+        ConnectionHandle::Lease db(handle);
+        if (!db)
             return docs;
 
-        PGresult *res = db->execute_query("SELECT doc_id, document_text, created_at FROM documents;");
+        PGresult *res = db->execute_prepared(Statements::GET_ALL_DOCUMENTS, nullptr, true);
         if (!res)
             return docs;
 
         int n = PQntuples(res);
         for (int i = 0; i < n; ++i)
         {
-            docs.push_back({PQgetvalue(res, i, 0),
-                            PQgetvalue(res, i, 1),
-                            PQgetvalue(res, i, 2)});
+            docs.push_back({DBConnection::uuid_value(res, i, 0),
+                            DBConnection::text_value(res, i, 1),
+                            DBConnection::text_value(res, i, 2)});
         }
         PQclear(res);
     }
     catch (const exception &e)
     {
-        cerr << "Error occured at get_all_documents in repo " << e.what() << endl;
+        LOG_ERROR("Error occured at get_all_documents in repo " << e.what());
     }
     return docs;
 }
@@ -118,20 +233,21 @@ vector<Document> DocumentRepository::get_all_documents()
 int DocumentRepository::get_total_documents() {
     try
     {
-        if (!db || !db->is_connected())
+        ConnectionHandle::Lease db(handle);
+        if (!db)
             return 0;
 
-        PGresult *res = db->execute_query("SELECT COUNT(*) FROM documents;");
+        PGresult *res = db->execute_prepared(Statements::COUNT_DOCUMENTS, nullptr, true);
         if (!res)
             return 0;
 
-        int total = stoi(PQgetvalue(res, 0, 0));
+        int total = static_cast<int>(DBConnection::int_value(res, 0, 0));
         PQclear(res);
         return total;
     }
     catch (const exception &e)
     {
-        cerr << "Error occured at get_total_documents in repo " << e.what() << endl;
+        LOG_ERROR("Error occured at get_total_documents in repo " << e.what());
         return 0;
     }
 }
@@ -141,30 +257,31 @@ bool DocumentRepository::delete_document(const string &doc_id)
 {
     try
     {
-        if (!db || !db->is_connected())
+        ConnectionHandle::Lease db(handle);
+        if (!db)
             return false;
 
-        string query = "DELETE FROM documents WHERE doc_id = '" + doc_id + "';";
-        PGresult *res = db->execute_query(query);
+        const char *paramValues[1] = {doc_id.c_str()};
+        PGresult *res = db->execute_prepared(Statements::DELETE_DOCUMENT, paramValues);
         if (!res)
             return false;
 
         int affected_rows = stoi(PQcmdTuples(res));
         if (affected_rows == 0)
         {
-            cerr << "No document found with doc_id: " << doc_id << endl;
+            LOG_ERROR("No document found with doc_id: " << doc_id);
             PQclear(res);
             return false;
         }
 
-        cout << "Deleted " << affected_rows << " document(s) with doc_id: " << doc_id << endl;
+        LOG_INFO("Deleted " << affected_rows << " document(s) with doc_id: " << doc_id);
 
         PQclear(res);
         return true;
     }
     catch (const exception &e)
     {
-        cerr << "Error occured at delete_document in repo " << e.what() << endl;
+        LOG_ERROR("Error occured at delete_document in repo " << e.what());
         return false;
     }
 }
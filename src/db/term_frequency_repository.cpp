@@ -1,15 +1,36 @@
 #include "db/term_frequency_repository.h"
-#include <iostream>
+#include "utils/logger.h"
 #include <libpq-fe.h>
 
 using namespace std;
 
+// text[] literal of words for a single query parameter, every element quoted
+static string to_text_array(const vector<string> &words)
+{
+    string array = "{";
+    for (size_t i = 0; i < words.size(); ++i)
+    {
+        if (i > 0)
+            array += ",";
+        array += "\"";
+        for (char c : words[i])
+        {
+            if (c == '"' || c == '\\')
+                array += '\\';
+            array += c;
+        }
+        array += "\"";
+    }
+    array += "}";
+    return array;
+}
+
 // implementing the constructor
-TermFrequencyRepository::TermFrequencyRepository(DBConnection* db_conn) {
-    db = db_conn;
+TermFrequencyRepository::TermFrequencyRepository(ConnectionHandle* db_handle) {
+    handle = db_handle;
 }
 
-// Bulk insert/update term frequencies
+// Bulk insert term frequencies, all rows in one COPY
 bool TermFrequencyRepository::insert_term_frequencies_bulk(
     const vector<TermFrequency> &term_frequencies)
 {
@@ -17,82 +38,184 @@ bool TermFrequencyRepository::insert_term_frequencies_bulk(
     {
 
         // return empty in case db is not connected or the vector of term_frequencies is empty
-        if (!db || !db->is_connected() || term_frequencies.empty())
+        if (term_frequencies.empty())
+            return false;
+        ConnectionHandle::Lease db(handle);
+        if (!db)
             return false;
 
-        bool all_success = true;
-
+        // rows in COPY text format: doc_id \t word \t word_frequency \n
+        string data;
+        data.reserve(term_frequencies.size() * 64);
+        char frequency[32];
         for (const auto &tf : term_frequencies)
         {
-            const char *params[3] = {
-                // c_str is a constant character pointer to the string object
-                tf.doc_id.c_str(),
-                tf.word.c_str(),
-                to_string(tf.word_frequency).c_str()};
-
-            PGresult *res = PQexecParams(db->get_conn(),
-                                         "INSERT INTO term_frequency (doc_id, word, word_frequency) "
-                                         "VALUES (CAST($1 AS UUID), $2, $3) "
-                                         "ON CONFLICT (doc_id, word) DO UPDATE SET word_frequency = EXCLUDED.word_frequency;",
-                                         3, // number of parameters
-                                         nullptr,
-                                         params,
-                                         nullptr, // param lengths
-                                         nullptr, // param formats
-                                         0);
-
-            if (!res || PQresultStatus(res) != PGRES_COMMAND_OK)
-            {
-                cerr << "Insert failed for word '" << tf.word
-                     << "': " << PQerrorMessage(db->get_conn()) << endl;
-                all_success = false;
-            }
+            DBConnection::append_copy_field(data, tf.doc_id);
+            data += '\t';
+            DBConnection::append_copy_field(data, tf.word);
+            data += '\t';
+            // 9 significant digits round trip a float exactly
+            snprintf(frequency, sizeof(frequency), "%.9g", tf.word_frequency);
+            data += frequency;
+            data += '\n';
+        }
+
+        // a single round trip instead of one INSERT per word. Rows of a new document never
+        // conflict; a duplicate (doc_id, word) fails the COPY and with it the transaction
+        bool ok = db->copy_in("COPY term_frequency (doc_id, word, word_frequency) FROM STDIN;", data);
+        if (!ok)
+            LOG_ERROR("Bulk insert of " << term_frequencies.size() << " term frequencies failed");
+        return ok;
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Error occured at bulkInsertion " << e.what());
+        return false;
+    }
+}
+
+// Queue the insert of term frequencies on a connection in pipeline mode
+bool TermFrequencyRepository::send_insert_term_frequencies(const vector<TermFrequency> &term_frequencies)
+{
+    try
+    {
+        if (term_frequencies.empty())
+            return false;
+        ConnectionHandle::Lease db(handle);
+        if (!db)
+            return false;
 
-            if (res)
-                PQclear(res);
+        // COPY is not allowed in a pipeline, the rows travel as three parallel arrays instead
+        vector<string> doc_ids, words;
+        string frequencies = "{";
+        char frequency[32];
+        for (size_t i = 0; i < term_frequencies.size(); ++i)
+        {
+            doc_ids.push_back(term_frequencies[i].doc_id);
+            words.push_back(term_frequencies[i].word);
+            snprintf(frequency, sizeof(frequency), "%.9g", term_frequencies[i].word_frequency);
+            if (i > 0)
+                frequencies += ",";
+            frequencies += frequency;
         }
+        frequencies += "}";
 
-        return all_success;
+        string doc_id_array = to_text_array(doc_ids), word_array = to_text_array(words);
+        const char *paramValues[3] = {doc_id_array.c_str(), word_array.c_str(), frequencies.c_str()};
+        return db->send_query(Statements::INSERT_TERM_FREQUENCIES, paramValues);
     }
     catch (const exception &e)
     {
-        cerr << "Error occured at bulkInsertion " << e.what() << endl;
+        LOG_ERROR("Error occured at send_insert_term_frequencies: " << e.what());
         return false;
     }
 }
 
 // Retrieve TermFrequency for a set of query words
-vector<TermFrequency> TermFrequencyRepository::get_word_stats_for_query(
+optional<vector<TermFrequency>> TermFrequencyRepository::get_word_stats_for_query(
     const vector<string> &words)
 {
-    vector<TermFrequency> results;
     try
     {
-        if (!db || !db->is_connected() || words.empty())
+        return fetch_word_stats_for_query(words).get();
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Error occured at get_word_stats_for_query: " << e.what());
+        return nullopt;
+    }
+}
+
+future<optional<vector<TermFrequency>>> TermFrequencyRepository::fetch_word_stats_for_query(const vector<string> &words)
+{
+    if (words.empty())
+    {
+        promise<optional<vector<TermFrequency>>> none;
+        none.set_value(vector<TermFrequency>());
+        return none.get_future();
+    }
+
+    // one array parameter instead of quoting every word into an IN list
+    return handle->query<optional<vector<TermFrequency>>>(
+        Statements::GET_TERM_FREQUENCIES_FOR_WORDS, {to_text_array(words)}, true,
+        [](const PGresult *res) -> optional<vector<TermFrequency>>
+        {
+            // failed or never sent, not the same as no postings
+            if (!res)
+                return nullopt;
+
+            vector<TermFrequency> results;
+            int n = PQntuples(res);
+            results.reserve(n);
+            for (int i = 0; i < n; ++i)
+            {
+                results.push_back({
+                    DBConnection::uuid_value(res, i, 1), // doc_id
+                    DBConnection::text_value(res, i, 0), // word
+                    DBConnection::real_value(res, i, 2)  // word_frequency
+                });
+            }
+            return results;
+        });
+}
+
+// Retrieve word vs document count
+vector<IDFStats> TermFrequencyRepository::get_all_idf_stats()
+{
+    vector<IDFStats> results;
+    try
+    {
+        // Validate DB connection
+        ConnectionHandle::Lease db(handle);
+        if (!db)
             return results;
 
-        // Build query with IN clause
-        string query = "SELECT word, doc_id, word_frequency "
-                       "FROM term_frequency "
-                       "WHERE word IN (";
+        // Query to count number of documents per word
+        PGresult *res = db->execute_prepared(Statements::COUNT_DOCUMENTS_PER_WORD, nullptr, true);
+        if (!res)
+            return results;
 
-        for (size_t i = 0; i < words.size(); ++i)
+        // Parse results
+        int n = PQntuples(res);
+        for (int i = 0; i < n; ++i)
         {
-            if (i > 0)
-                query += ",";
-            query += "'" + words[i] + "'";
+            results.push_back({
+                DBConnection::text_value(res, i, 0),                  // word
+                static_cast<int>(DBConnection::int_value(res, i, 1)) // document_count
+            });
         }
-        query += ");";
 
-        PGresult* res = db->execute_query(query);
-        if (!res) return results;
+        PQclear(res);
+        return results;
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Exception occured while getting all idf stats: " << e.what());
+        return results;
+    }
+}
+// Retrieve the whole term_frequency table
+vector<TermFrequency> TermFrequencyRepository::get_all_term_frequencies()
+{
+    vector<TermFrequency> results;
+    try
+    {
+        ConnectionHandle::Lease db(handle);
+        if (!db)
+            return results;
+
+        PGresult *res = db->execute_prepared(Statements::GET_ALL_TERM_FREQUENCIES, nullptr, true);
+        if (!res)
+            return results;
 
         int n = PQntuples(res);
-        for (int i = 0; i < n; ++i) {
+        results.reserve(n);
+        for (int i = 0; i < n; ++i)
+        {
             results.push_back({
-                PQgetvalue(res, i, 1),      // word
-                PQgetvalue(res, i, 0),      // doc_id
-                stof(PQgetvalue(res, i, 2)) // word_frequency
+                DBConnection::uuid_value(res, i, 0), // doc_id
+                DBConnection::text_value(res, i, 1), // word
+                DBConnection::real_value(res, i, 2)  // word_frequency
             });
         }
 
@@ -100,48 +223,160 @@ vector<TermFrequency> TermFrequencyRepository::get_word_stats_for_query(
     }
     catch (const exception &e)
     {
-        cerr << "Error occured at get_word_stats_for_query: " << e.what() << endl;
+        LOG_ERROR("Error occured at get_all_term_frequencies: " << e.what());
     }
     return results;
 }
 
-// Retrieve word vs document count
-vector<IDFStats> TermFrequencyRepository::get_all_idf_stats()
+// Count a new document in word_df
+bool TermFrequencyRepository::increment_document_frequencies(const vector<string> &words)
+{
+    try
+    {
+        ConnectionHandle::Lease db(handle);
+        if (!db)
+            return false;
+        if (words.empty())
+            return true;
+
+        string word_array = to_text_array(words);
+        const char *paramValues[1] = {word_array.c_str()};
+        PGresult *res = db->execute_prepared(Statements::INCREMENT_DOCUMENT_FREQUENCIES, paramValues);
+        if (!res)
+            return false;
+
+        PQclear(res);
+        return true;
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Error occured at increment_document_frequencies: " << e.what());
+        return false;
+    }
+}
+
+// Queue counting a new document in word_df on a connection in pipeline mode
+bool TermFrequencyRepository::send_increment_document_frequencies(const vector<string> &words)
+{
+    try
+    {
+        ConnectionHandle::Lease db(handle);
+        if (!db)
+            return false;
+        if (words.empty())
+            return true;
+
+        string word_array = to_text_array(words);
+        const char *paramValues[1] = {word_array.c_str()};
+        return db->send_query(Statements::INCREMENT_DOCUMENT_FREQUENCIES, paramValues);
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Error occured at send_increment_document_frequencies: " << e.what());
+        return false;
+    }
+}
+
+// Count a document out of word_df, returns its words
+optional<vector<string>> TermFrequencyRepository::decrement_document_frequencies(const string &doc_id)
+{
+    try
+    {
+        ConnectionHandle::Lease db(handle);
+        if (!db)
+            return nullopt;
+
+        const char *docParam[1] = {doc_id.c_str()};
+        PGresult *res = db->execute_prepared(Statements::GET_DOCUMENT_WORDS, docParam, true);
+        if (!res)
+            return nullopt;
+
+        vector<string> words;
+        int n = PQntuples(res);
+        words.reserve(n);
+        for (int i = 0; i < n; ++i)
+            words.push_back(DBConnection::text_value(res, i, 0));
+        PQclear(res);
+
+        if (words.empty())
+            return words;
+
+        string word_array = to_text_array(words);
+        const char *wordParam[1] = {word_array.c_str()};
+
+        // locked in word order like the increment
+        res = db->execute_prepared(Statements::DECREMENT_DOCUMENT_FREQUENCIES, wordParam);
+        if (!res)
+            return nullopt;
+        PQclear(res);
+
+        // words whose last document this was
+        res = db->execute_prepared(Statements::DELETE_UNUSED_DOCUMENT_FREQUENCIES, wordParam);
+        if (!res)
+            return nullopt;
+        PQclear(res);
+
+        return words;
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Error occured at decrement_document_frequencies: " << e.what());
+        return nullopt;
+    }
+}
+
+// Retrieve word_df
+vector<IDFStats> TermFrequencyRepository::get_document_frequencies()
 {
     vector<IDFStats> results;
     try
     {
-        // Validate DB connection
-        if (!db || !db->is_connected())
+        ConnectionHandle::Lease db(handle);
+        if (!db)
             return results;
 
-        // Query to count number of documents per word
-        string query =
-            "SELECT word, COUNT(DISTINCT doc_id) AS document_count "
-            "FROM term_frequency "
-            "GROUP BY word;";
-
-        // Execute query using your DB wrapper
-        PGresult *res = db->execute_query(query);
+        PGresult *res = db->execute_prepared(Statements::GET_DOCUMENT_FREQUENCIES, nullptr, true);
         if (!res)
             return results;
 
-        // Parse results
         int n = PQntuples(res);
+        results.reserve(n);
         for (int i = 0; i < n; ++i)
         {
             results.push_back({
-                PQgetvalue(res, i, 0),      // word
-                stoi(PQgetvalue(res, i, 1)) // document_count
+                DBConnection::text_value(res, i, 0),                  // word
+                static_cast<int>(DBConnection::int_value(res, i, 1)) // document_count
             });
         }
 
         PQclear(res);
-        return results;
     }
     catch (const exception &e)
     {
-        cerr << "Exception occured while getting all idf stats: " << e.what() << endl;
-        return results;
+        LOG_ERROR("Error occured at get_document_frequencies: " << e.what());
     }
-}
\ No newline at end of file
+    return results;
+}
+
+// Fill word_df from term_frequency
+bool TermFrequencyRepository::backfill_document_frequencies()
+{
+    try
+    {
+        ConnectionHandle::Lease db(handle);
+        if (!db)
+            return false;
+
+        PGresult *res = db->execute_prepared(Statements::BACKFILL_DOCUMENT_FREQUENCIES, nullptr);
+        if (!res)
+            return false;
+
+        PQclear(res);
+        return true;
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Error occured at backfill_document_frequencies: " << e.what());
+        return false;
+    }
+}
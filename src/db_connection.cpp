@@ -1,5 +1,6 @@
 #include "db_connection.h"
-#include <iostream>
+#include "utils/logger.h"
+#include <cstring>
 
 using namespace std;
 // https://www.postgresql.org/docs/current/libpq-example.html reference
@@ -24,16 +25,33 @@ DBConnection::DBConnection(const string &db_name,
     if (PQstatus(conn) != CONNECTION_OK)
     {
         // the connection has failed and we can't start server unless this is true
-        cerr << "Connection failed: " << PQerrorMessage(conn);
+        LOG_ERROR("Connection failed: " << PQerrorMessage(conn));
         PQfinish(conn);
         conn = nullptr;
     }
     else
     {
-        cout << "Connected to database: " << db_name << endl;
+        LOG_INFO("Connected to database: " << db_name);
+        prepare_statements();
     }
 }
 
+bool DBConnection::prepare_statements()
+{
+    bool ok = true;
+    for (const Statement *statement : Statements::ALL)
+    {
+        // parameter types come from the casts in the sql
+        PGresult* res = PQprepare(conn, statement->name, statement->sql, statement->n_params, nullptr);
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+            LOG_ERROR("Failed to prepare " << statement->name << ": " << PQerrorMessage(conn));
+            ok = false;
+        }
+        PQclear(res);
+    }
+    return ok;
+}
+
 // implementing the disconnect DB method
 DBConnection::~DBConnection()
 {
@@ -41,7 +59,7 @@ DBConnection::~DBConnection()
     {
         // closes the connection
         PQfinish(conn);
-        cout << "Connection closed." << endl;
+        LOG_INFO("Connection closed.");
     }
 }
 
@@ -59,7 +77,25 @@ PGresult *DBConnection::execute_query(const string &query)
     ExecStatusType status = PQresultStatus(res);
 
     if (status != PGRES_TUPLES_OK && status != PGRES_COMMAND_OK) {
-        cerr << "Query failed: " << PQerrorMessage(conn) << endl;
+        LOG_ERROR("Query failed: " << PQerrorMessage(conn));
+        PQclear(res);
+        return nullptr;
+    }
+
+    return res; // Note: To do PQclear(res) when done
+}
+
+PGresult *DBConnection::execute_prepared(const Statement &statement, const char *const *param_values,
+                                        bool binary_result)
+{
+    if (!is_connected()) return nullptr;
+
+    PGresult* res = PQexecPrepared(conn, statement.name, statement.n_params, param_values,
+                                   nullptr, nullptr, binary_result ? 1 : 0);
+    ExecStatusType status = PQresultStatus(res);
+
+    if (status != PGRES_TUPLES_OK && status != PGRES_COMMAND_OK) {
+        LOG_ERROR("Query " << statement.name << " failed: " << PQerrorMessage(conn));
         PQclear(res);
         return nullptr;
     }
@@ -67,22 +103,188 @@ PGresult *DBConnection::execute_query(const string &query)
     return res; // Note: To do PQclear(res) when done
 }
 
+// binary values arrive in network byte order
+static uint64_t read_big_endian(const unsigned char *bytes, int length)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < length; i++)
+        value = (value << 8) | bytes[i];
+    return value;
+}
+
+string DBConnection::text_value(const PGresult *res, int row, int column)
+{
+    return string(PQgetvalue(res, row, column), PQgetlength(res, row, column));
+}
+
+string DBConnection::uuid_value(const PGresult *res, int row, int column)
+{
+    // 16 raw bytes, printed the way postgres prints a uuid
+    static const char HEX[] = "0123456789abcdef";
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(PQgetvalue(res, row, column));
+    string uuid;
+    uuid.reserve(36);
+    for (int i = 0; i < 16; i++)
+    {
+        if (i == 4 || i == 6 || i == 8 || i == 10)
+            uuid += '-';
+        uuid += HEX[bytes[i] >> 4];
+        uuid += HEX[bytes[i] & 0xF];
+    }
+    return uuid;
+}
+
+float DBConnection::real_value(const PGresult *res, int row, int column)
+{
+    uint32_t bits = static_cast<uint32_t>(
+        read_big_endian(reinterpret_cast<const unsigned char *>(PQgetvalue(res, row, column)), 4));
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+int64_t DBConnection::int_value(const PGresult *res, int row, int column)
+{
+    // int2, int4 or int8, sign extended from its width
+    int length = PQgetlength(res, row, column);
+    if (length == 0)
+        return 0;
+    uint64_t bits = read_big_endian(reinterpret_cast<const unsigned char *>(PQgetvalue(res, row, column)), length);
+    int shift = 64 - 8 * length;
+    return static_cast<int64_t>(bits << shift) >> shift;
+}
+
+bool DBConnection::copy_in(const string &copy_statement, const string &data)
+{
+    if (!is_connected()) return false;
+
+    PGresult* res = PQexec(conn, copy_statement.c_str());
+    if (PQresultStatus(res) != PGRES_COPY_IN) {
+        LOG_ERROR("COPY failed to start: " << PQerrorMessage(conn));
+        PQclear(res);
+        return false;
+    }
+    PQclear(res);
+
+    // blocking connection: both calls only return once libpq buffered or sent the data
+    bool sent = PQputCopyData(conn, data.data(), static_cast<int>(data.size())) == 1;
+    if (PQputCopyEnd(conn, sent ? nullptr : "client failed to send rows") != 1)
+        sent = false;
+
+    // the COPY's own result, then the terminating null
+    bool ok = sent;
+    while ((res = PQgetResult(conn)) != nullptr) {
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+            LOG_ERROR("COPY failed: " << PQerrorMessage(conn));
+            ok = false;
+        }
+        PQclear(res);
+    }
+    return ok;
+}
+
+void DBConnection::append_copy_field(string &row, const string &value)
+{
+    for (char c : value)
+    {
+        switch (c)
+        {
+        case '\\': row += "\\\\"; break;
+        case '\t': row += "\\t"; break;
+        case '\n': row += "\\n"; break;
+        case '\r': row += "\\r"; break;
+        default: row += c;
+        }
+    }
+}
+
+bool DBConnection::begin_pipeline()
+{
+    if (!is_connected()) return false;
+
+    if (PQenterPipelineMode(conn) != 1) {
+        LOG_ERROR("Failed to enter pipeline mode: " << PQerrorMessage(conn));
+        return false;
+    }
+    pipeline_pending = 0;
+    pipeline_failed = false;
+    return true;
+}
+
+bool DBConnection::send_query(const Statement &statement, const char *const *param_values)
+{
+    // nothing goes out once a send failed, end_pipeline reports the failure
+    if (pipeline_failed) return false;
+
+    if (PQsendQueryPrepared(conn, statement.name, statement.n_params, param_values, nullptr, nullptr, 0) != 1) {
+        LOG_ERROR("Failed to send query: " << PQerrorMessage(conn));
+        pipeline_failed = true;
+        return false;
+    }
+    pipeline_pending++;
+    return true;
+}
+
+bool DBConnection::end_pipeline()
+{
+    bool ok = !pipeline_failed;
+
+    // the sync flushes everything queued and closes the implicit transaction
+    if (PQpipelineSync(conn) != 1) {
+        LOG_ERROR("Pipeline sync failed: " << PQerrorMessage(conn));
+        ok = false;
+    }
+    else {
+        // each query yields its result followed by a null, the sync its own result.
+        // After an error the remaining queries come back PGRES_PIPELINE_ABORTED.
+        for (int i = 0; i < pipeline_pending; i++) {
+            PGresult* res;
+            while ((res = PQgetResult(conn)) != nullptr) {
+                ExecStatusType status = PQresultStatus(res);
+                if (status == PGRES_FATAL_ERROR) {
+                    LOG_ERROR("Pipelined query failed: " << PQresultErrorMessage(res));
+                    ok = false;
+                }
+                else if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK) {
+                    ok = false;
+                }
+                PQclear(res);
+            }
+        }
+
+        PGresult* res = PQgetResult(conn);
+        if (PQresultStatus(res) != PGRES_PIPELINE_SYNC) {
+            LOG_ERROR("Pipeline sync failed: " << PQerrorMessage(conn));
+            ok = false;
+        }
+        PQclear(res);
+    }
+
+    pipeline_pending = 0;
+    pipeline_failed = false;
+    if (PQexitPipelineMode(conn) != 1) {
+        LOG_ERROR("Failed to exit pipeline mode: " << PQerrorMessage(conn));
+        ok = false;
+    }
+    return ok;
+}
+
 // for internal use only
 void DBConnection::test_connection() {
     if (!is_connected()) {
-        cerr << "Not connected to DB." << endl;
+        LOG_ERROR("Not connected to DB.");
         return;
     }
 
     PGresult* res = execute_query("SELECT version();");
     if (!res) {
-        cerr << "Failed to execute test query." << endl;
+        LOG_ERROR("Failed to execute test query.");
         return;
     }
 
     // There should be only one row and one column
     char* version = PQgetvalue(res, 0, 0);
-    cout << "PostgreSQL version: " << version << endl;
+    LOG_INFO("PostgreSQL version: " << version);
 
     PQclear(res);
 }
@@ -92,6 +294,30 @@ PGconn* DBConnection::get_conn() const {
     return conn;
 }
 
+bool DBConnection::ping() {
+    PGresult* res = execute_query("SELECT 1;");
+    if (!res) return false;
+    PQclear(res);
+    return true;
+}
+
+bool DBConnection::reconnect() {
+    if (conn)
+        PQreset(conn);
+    else
+        conn = PQconnectdb(connection_str.c_str());
+
+    if (PQstatus(conn) != CONNECTION_OK) {
+        LOG_ERROR("Reconnect failed: " << PQerrorMessage(conn));
+        return false;
+    }
+
+    // prepared statements lived in the old session
+    prepare_statements();
+    LOG_INFO("Reconnected to database");
+    return true;
+}
+
 bool DBConnection::begin_transaction() {
     PGresult* res = execute_query("BEGIN;");
     if (!res) return false;
@@ -0,0 +1,82 @@
+#include "index/doc_id_dictionary.h"
+
+using namespace std;
+
+DocIdDictionary::DocIdDictionary()
+{
+    pthread_rwlock_init(&lock_, nullptr);
+}
+
+DocIdDictionary::~DocIdDictionary()
+{
+    pthread_rwlock_destroy(&lock_);
+}
+
+uint32_t DocIdDictionary::get_or_assign(const string &doc_id)
+{
+    // fast path, the document is already known
+    pthread_rwlock_rdlock(&lock_);
+    auto it = ordinals_.find(doc_id);
+    if (it != ordinals_.end())
+    {
+        uint32_t ordinal = it->second;
+        pthread_rwlock_unlock(&lock_);
+        return ordinal;
+    }
+    pthread_rwlock_unlock(&lock_);
+
+    pthread_rwlock_wrlock(&lock_);
+    uint32_t ordinal;
+    try
+    {
+        // someone else may have assigned it between the two locks
+        auto result = ordinals_.emplace(doc_id, static_cast<uint32_t>(doc_ids_.size()));
+        if (result.second)
+            doc_ids_.push_back(doc_id);
+        ordinal = result.first->second;
+    }
+    catch (...)
+    {
+        pthread_rwlock_unlock(&lock_);
+        throw;
+    }
+    pthread_rwlock_unlock(&lock_);
+    return ordinal;
+}
+
+optional<uint32_t> DocIdDictionary::find(const string &doc_id)
+{
+    pthread_rwlock_rdlock(&lock_);
+    optional<uint32_t> ordinal;
+    auto it = ordinals_.find(doc_id);
+    if (it != ordinals_.end())
+        ordinal = it->second;
+    pthread_rwlock_unlock(&lock_);
+    return ordinal;
+}
+
+string DocIdDictionary::doc_id(uint32_t ordinal)
+{
+    pthread_rwlock_rdlock(&lock_);
+    string result;
+    try
+    {
+        if (ordinal < doc_ids_.size())
+            result = doc_ids_[ordinal];
+    }
+    catch (...)
+    {
+        pthread_rwlock_unlock(&lock_);
+        throw;
+    }
+    pthread_rwlock_unlock(&lock_);
+    return result;
+}
+
+size_t DocIdDictionary::size()
+{
+    pthread_rwlock_rdlock(&lock_);
+    size_t count = doc_ids_.size();
+    pthread_rwlock_unlock(&lock_);
+    return count;
+}
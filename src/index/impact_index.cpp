@@ -0,0 +1,349 @@
+#include "index/impact_index.h"
+#include "index/doc_id_dictionary.h"
+#include "index/stream_vbyte.h"
+#include "utils/logger.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+using namespace std;
+
+namespace
+{
+    // segments are coded in chunks of this many ordinals so decoding needs a fixed buffer only
+    constexpr size_t CHUNK_SIZE = 128;
+
+    // integer counterpart of ScoreAccumulator, see there for the stamp scheme. Also records
+    // which query words (bit i = word i, the first 32) already scored each document. The
+    // three fields of a document share one slot so an add touches a single cache line.
+    struct ImpactAccumulator
+    {
+        struct Slot
+        {
+            uint32_t stamp;
+            uint32_t score;
+            uint32_t words;
+        };
+
+        vector<Slot> slots;
+        vector<uint32_t> touched;
+        uint32_t epoch = 0;
+
+        void begin(size_t num_docs)
+        {
+            if (slots.size() < num_docs)
+                slots.resize(num_docs, Slot{0, 0, 0});
+            touched.clear();
+
+            if (++epoch == 0)
+            {
+                for (auto &slot : slots)
+                    slot.stamp = 0;
+                epoch = 1;
+            }
+        }
+
+        // returns the document's new sum
+        uint32_t add(uint32_t doc, uint32_t impact, uint32_t word_bit)
+        {
+            Slot &slot = slots[doc];
+            if (slot.stamp != epoch)
+            {
+                slot = {epoch, 0, 0};
+                touched.push_back(doc);
+            }
+            slot.score += impact;
+            slot.words |= word_bit;
+            return slot.score;
+        }
+    };
+
+    thread_local ImpactAccumulator accumulator;
+
+    // word i of the query only ever sets bit i, words past 32 are never marked as done
+    uint32_t word_bit(size_t i)
+    {
+        return i < 32 ? 1u << i : 0;
+    }
+
+    // ranks_before on (impact sum, ordinal) pairs
+    bool impact_ranks_before(const pair<uint32_t, uint32_t> &a, const pair<uint32_t, uint32_t> &b)
+    {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    }
+
+    // The k best (impact sum, ordinal) pairs in ranking order seen so far. Sums only grow,
+    // so offering every document after each add keeps this exact: a document either
+    // updates its own entry or pushes out the worst one.
+    class BestK
+    {
+    private:
+        size_t k_;
+        vector<pair<uint32_t, uint32_t>> best_;
+        size_t worst_ = 0; // index of the entry ranked last, valid once full
+
+        bool full() const { return best_.size() == k_; }
+
+    public:
+        explicit BestK(size_t k) : k_(k) { best_.reserve(k); }
+
+        // k-th best sum, 0 until k documents were seen
+        uint32_t threshold() const { return full() ? best_[worst_].first : 0; }
+
+        bool contains(uint32_t doc) const
+        {
+            for (const auto &entry : best_)
+            {
+                if (entry.second == doc)
+                    return true;
+            }
+            return false;
+        }
+
+        void offer(uint32_t doc, uint32_t score)
+        {
+            pair<uint32_t, uint32_t> candidate{score, doc};
+            if (full() && !impact_ranks_before(candidate, best_[worst_]))
+                return;
+
+            auto it = best_.begin();
+            while (it != best_.end() && it->second != doc)
+                ++it;
+            if (it != best_.end())
+                it->first = score;
+            else if (!full())
+                best_.push_back(candidate);
+            else
+                best_[worst_] = candidate;
+
+            if (full())
+            {
+                worst_ = 0;
+                for (size_t i = 1; i < best_.size(); i++)
+                {
+                    if (impact_ranks_before(best_[worst_], best_[i]))
+                        worst_ = i;
+                }
+            }
+        }
+
+        vector<pair<uint32_t, uint32_t>> sorted() const
+        {
+            vector<pair<uint32_t, uint32_t>> ranked = best_;
+            sort(ranked.begin(), ranked.end(), impact_ranks_before);
+            return ranked;
+        }
+    };
+
+    // True once no document outside the current best k can still overtake one inside.
+    // A seen document can at most gain the next impact of every word that has not scored
+    // it yet, an unseen one the next impacts of all words (pending_total). Only the
+    // membership of the top-k matters, callers rescore it exactly.
+    bool top_k_settled(const ImpactAccumulator &acc, const BestK &best, size_t k, const vector<uint32_t> &pending,
+                       uint32_t pending_total)
+    {
+        // cheap test first, it fails for most of the query
+        uint32_t kth = best.threshold();
+        if (acc.touched.size() < k || pending_total > kth)
+            return false;
+
+        for (uint32_t doc : acc.touched)
+        {
+            const auto &slot = acc.slots[doc];
+            uint32_t bound = slot.score;
+            uint32_t seen = slot.words;
+            for (size_t w = 0; w < pending.size(); w++)
+            {
+                if (!(seen & word_bit(w)))
+                    bound += pending[w];
+            }
+            if (bound > kth && !best.contains(doc))
+                return false;
+        }
+        return true;
+    }
+}
+
+ImpactIndex::ImpactIndex(unsigned bits)
+    : bits_(bits == 16 ? 16 : 8)
+{
+    pthread_mutex_init(&lock_, nullptr);
+}
+
+ImpactIndex::~ImpactIndex()
+{
+    pthread_mutex_destroy(&lock_);
+}
+
+shared_ptr<const ImpactIndex::Snapshot> ImpactIndex::snapshot()
+{
+    pthread_mutex_lock(&lock_);
+    shared_ptr<const Snapshot> current = snapshot_;
+    pthread_mutex_unlock(&lock_);
+    return current;
+}
+
+bool ImpactIndex::ready()
+{
+    return snapshot() != nullptr;
+}
+
+void ImpactIndex::rebuild(InvertedIndex &index, IDFTable &idf_table)
+{
+    auto next = make_shared<Snapshot>();
+    const uint32_t max_impact = (1u << bits_) - 1;
+
+    // first pass: idf of every word and the largest score any posting can have,
+    // which maps to max_impact. Words with a non-positive idf only lower scores and are left out.
+    unordered_map<string, double> idfs;
+    double max_score = 0.0;
+    index.for_each_list([&](const string &word, const PostingList &list)
+                        {
+                            double idf = idf_table.get_idf(word);
+                            if (idf <= 0.0)
+                                return;
+                            idfs[word] = idf;
+                            max_score = max(max_score, list.max_word_frequency() * idf);
+                        });
+
+    if (max_score > 0.0)
+    {
+        next->score_per_impact = max_score / max_impact;
+
+        // second pass: quantize and group by impact. Words added since the first pass have no idf yet.
+        vector<pair<uint16_t, uint32_t>> impacts; // (impact, doc)
+        uint32_t deltas[CHUNK_SIZE];
+        index.for_each_list([&](const string &word, const PostingList &list)
+                            {
+                                auto idf_it = idfs.find(word);
+                                if (idf_it == idfs.end())
+                                    return;
+                                double idf = idf_it->second;
+
+                                impacts.clear();
+                                list.for_each([&](uint32_t doc, float word_frequency)
+                                              {
+                                                  long level = lround(word_frequency * idf / next->score_per_impact);
+                                                  // impact 0 adds nothing, the posting is dropped
+                                                  if (level > 0)
+                                                      impacts.push_back({static_cast<uint16_t>(min<long>(level, max_impact)), doc});
+                                              });
+                                // documents created during the passes got ordinals past the
+                                // dictionary size read before them, size the snapshot by what it holds
+                                for (const auto &impact : impacts)
+                                    next->num_docs = max<size_t>(next->num_docs, impact.second + 1);
+                                if (impacts.empty())
+                                    return;
+
+                                // highest impact first, ordinals stay ascending inside a segment
+                                stable_sort(impacts.begin(), impacts.end(), [](const auto &a, const auto &b)
+                                            { return a.first > b.first; });
+
+                                ImpactList &out = next->lists[word];
+                                for (size_t begin = 0; begin < impacts.size();)
+                                {
+                                    size_t end = begin;
+                                    while (end < impacts.size() && impacts[end].first == impacts[begin].first)
+                                        end++;
+                                    out.segments.push_back({impacts[begin].first, static_cast<uint32_t>(end - begin),
+                                                            static_cast<uint32_t>(out.doc_bytes.size())});
+
+                                    uint32_t previous = 0;
+                                    for (size_t chunk = begin; chunk < end; chunk += CHUNK_SIZE)
+                                    {
+                                        size_t count = min(CHUNK_SIZE, end - chunk);
+                                        for (size_t i = 0; i < count; i++)
+                                        {
+                                            deltas[i] = impacts[chunk + i].second - previous;
+                                            previous = impacts[chunk + i].second;
+                                        }
+                                        size_t offset = out.doc_bytes.size();
+                                        out.doc_bytes.resize(offset + stream_vbyte::max_encoded_bytes(count));
+                                        out.doc_bytes.resize(offset + stream_vbyte::encode(deltas, count, out.doc_bytes.data() + offset));
+                                    }
+                                    begin = end;
+                                }
+                                out.doc_bytes.shrink_to_fit();
+                            });
+    }
+
+    LOG_INFO("Impact index rebuilt: " << next->lists.size() << " words, " << bits_ << " bit impacts");
+
+    pthread_mutex_lock(&lock_);
+    snapshot_ = move(next);
+    pthread_mutex_unlock(&lock_);
+}
+
+vector<ScoredDoc> ImpactIndex::top_k(const vector<string> &words, size_t top_k)
+{
+    shared_ptr<const Snapshot> current = snapshot();
+    if (!current || top_k == 0)
+        return {};
+
+    vector<const ImpactList *> lists;
+    vector<size_t> segments;   // next segment to process per word
+    vector<uint32_t> pending;  // impact of that segment, 0 once a word is done
+    uint32_t pending_total = 0;
+    for (const auto &word : words)
+    {
+        auto it = current->lists.find(word);
+        if (it == current->lists.end())
+            continue;
+        lists.push_back(&it->second);
+        segments.push_back(0);
+        pending.push_back(it->second.segments[0].impact);
+        pending_total += pending.back();
+    }
+
+    ImpactAccumulator &acc = accumulator; // one thread_local lookup, not one per posting
+    // the dictionary only grows, this covers every ordinal of any snapshot
+    acc.begin(max(current->num_docs, DocIdDictionary::instance().size()));
+    BestK best(top_k);
+    uint32_t docs[CHUNK_SIZE];
+    size_t processed_since_check = 0;
+
+    while (pending_total > 0)
+    {
+        // score-at-a-time: the segment with the highest impact left goes next
+        size_t word = max_element(pending.begin(), pending.end()) - pending.begin();
+        const ImpactList &list = *lists[word];
+        const Segment &segment = list.segments[segments[word]];
+
+        const uint8_t *in = list.doc_bytes.data() + segment.offset;
+        const uint8_t *buffer_end = list.doc_bytes.data() + list.doc_bytes.size();
+        uint32_t doc = 0;
+        for (size_t done = 0; done < segment.count; done += CHUNK_SIZE)
+        {
+            size_t count = min<size_t>(CHUNK_SIZE, segment.count - done);
+            in += stream_vbyte::decode(in, buffer_end, count, docs);
+            for (size_t i = 0; i < count; i++)
+            {
+                doc += docs[i];
+                best.offer(doc, acc.add(doc, segment.impact, word_bit(word)));
+            }
+        }
+        processed_since_check += segment.count;
+
+        pending_total -= pending[word];
+        segments[word]++;
+        pending[word] = segments[word] < list.segments.size() ? list.segments[segments[word]].impact : 0;
+        pending_total += pending[word];
+
+        // nothing can settle while an unseen document could still beat the k-th sum. Past
+        // that, a check costs a pass over the candidates, so only do it once about as many
+        // postings were processed, which keeps the total work linear
+        if (pending_total > 0 && pending_total <= best.threshold() && processed_since_check >= acc.touched.size())
+        {
+            processed_since_check = 0;
+            if (top_k_settled(acc, best, top_k, pending, pending_total))
+                break;
+        }
+    }
+
+    vector<ScoredDoc> ranked;
+    for (const auto &[score, doc] : best.sorted())
+    {
+        ranked.push_back({doc, score * current->score_per_impact});
+    }
+    return ranked;
+}
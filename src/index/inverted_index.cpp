@@ -0,0 +1,118 @@
+#include "index/inverted_index.h"
+#include "index/doc_id_dictionary.h"
+#include "utils/logger.h"
+
+using namespace std;
+
+InvertedIndex::InvertedIndex()
+{
+    pthread_rwlock_init(&lock_, nullptr);
+}
+
+InvertedIndex::~InvertedIndex()
+{
+    pthread_rwlock_destroy(&lock_);
+}
+
+void InvertedIndex::load(const vector<TermFrequency> &records)
+{
+    auto &dictionary = DocIdDictionary::instance();
+
+    // group the rows per word first so every list is sorted exactly once
+    unordered_map<string, vector<Posting>> grouped;
+    unordered_map<uint32_t, vector<string>> doc_words;
+    for (const auto &rec : records)
+    {
+        uint32_t doc = dictionary.get_or_assign(rec.doc_id);
+        grouped[rec.word].push_back({doc, rec.word_frequency});
+        doc_words[doc].push_back(rec.word);
+    }
+
+    unordered_map<string, PostingList> postings;
+    for (auto &[word, list] : grouped)
+    {
+        postings.emplace(word, PostingList(move(list)));
+    }
+
+    pthread_rwlock_wrlock(&lock_);
+    postings_.swap(postings);
+    doc_words_.swap(doc_words);
+    LOG_INFO("Inverted index loaded: " << doc_words_.size() << " documents, "
+          << postings_.size() << " words");
+    pthread_rwlock_unlock(&lock_);
+}
+
+void InvertedIndex::add_document(const string &doc_id, const vector<TermFrequency> &term_freqs)
+{
+    uint32_t doc = DocIdDictionary::instance().get_or_assign(doc_id);
+
+    pthread_rwlock_wrlock(&lock_);
+    try
+    {
+        auto &words = doc_words_[doc];
+        for (const auto &tf : term_freqs)
+        {
+            postings_[tf.word].add(doc, tf.word_frequency);
+            words.push_back(tf.word);
+        }
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Error while adding document to inverted index: " << e.what());
+    }
+    pthread_rwlock_unlock(&lock_);
+}
+
+bool InvertedIndex::remove_document(const string &doc_id)
+{
+    auto doc = DocIdDictionary::instance().find(doc_id);
+    if (!doc)
+        return false;
+
+    pthread_rwlock_wrlock(&lock_);
+    bool removed = false;
+    try
+    {
+        auto doc_it = doc_words_.find(*doc);
+        if (doc_it != doc_words_.end())
+        {
+            // only the posting lists of this document's words have to be touched
+            for (const auto &word : doc_it->second)
+            {
+                auto it = postings_.find(word);
+                if (it == postings_.end())
+                    continue;
+
+                it->second.remove(*doc);
+
+                // drop words which no longer occur anywhere
+                if (it->second.empty())
+                    postings_.erase(it);
+            }
+            doc_words_.erase(doc_it);
+            removed = true;
+        }
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Error while removing document from inverted index: " << e.what());
+    }
+    pthread_rwlock_unlock(&lock_);
+    return removed;
+}
+
+size_t InvertedIndex::document_count()
+{
+    pthread_rwlock_rdlock(&lock_);
+    size_t count = doc_words_.size();
+    pthread_rwlock_unlock(&lock_);
+    return count;
+}
+
+size_t InvertedIndex::vocabulary_size()
+{
+    pthread_rwlock_rdlock(&lock_);
+    size_t count = postings_.size();
+    pthread_rwlock_unlock(&lock_);
+    return count;
+}
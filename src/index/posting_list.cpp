@@ -0,0 +1,218 @@
+#include "index/posting_list.h"
+#include "index/stream_vbyte.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+const PostingBlock PostingList::EXHAUSTED_BLOCK = {PostingList::END, 0.0f, 0.0f, 0, 0.0f, 0.0f};
+
+// largest quantized frequency, the block max maps to it
+static constexpr uint32_t FREQUENCY_LEVELS = 65535;
+
+static bool doc_less(const Posting &a, const Posting &b)
+{
+    return a.doc < b.doc;
+}
+
+PostingList::Cursor::Cursor(const PostingList &list)
+    : list_(&list), block_(0), pos_(0), count_(0), shallow_block_(0)
+{
+    load_block(0);
+}
+
+void PostingList::Cursor::load_block(size_t b)
+{
+    block_ = b;
+    pos_ = 0;
+    count_ = b < list_->blocks_.size() ? list_->decode_docs(b, docs_) : 0;
+}
+
+void PostingList::Cursor::next_geq(uint32_t target)
+{
+    if (doc() >= target)
+        return;
+
+    // skip whole blocks first using their last ordinal, they are never decoded
+    size_t block = block_;
+    while (block < list_->blocks_.size() && list_->blocks_[block].last_doc < target)
+        block++;
+    if (block != block_)
+        load_block(block);
+
+    pos_ = lower_bound(docs_ + pos_, docs_ + count_, target) - docs_;
+}
+
+bool PostingList::Cursor::shallow_next_geq(uint32_t target)
+{
+    const auto &blocks = list_->blocks_;
+    // never look at blocks the cursor already left behind
+    shallow_block_ = max(shallow_block_, block_);
+    while (shallow_block_ < blocks.size() && blocks[shallow_block_].last_doc < target)
+        shallow_block_++;
+    return shallow_block_ < blocks.size();
+}
+
+PostingList::PostingList(vector<Posting> postings)
+{
+    sort(postings.begin(), postings.end(), doc_less);
+    append_blocks(postings);
+}
+
+size_t PostingList::block_size(size_t b) const
+{
+    return b + 1 < blocks_.size() ? BLOCK_SIZE : size_ - b * BLOCK_SIZE;
+}
+
+size_t PostingList::decode_docs(size_t b, uint32_t *docs) const
+{
+    size_t count = block_size(b);
+    // decode may read a few bytes ahead, but never past the end of doc_bytes_
+    stream_vbyte::decode(doc_bytes_.data() + blocks_[b].doc_offset, doc_bytes_.data() + doc_bytes_.size(), count, docs);
+
+    // deltas back to ordinals, the first one is relative to the previous block
+    uint32_t doc = b > 0 ? blocks_[b - 1].last_doc : 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        doc += docs[i];
+        docs[i] = doc;
+    }
+    return count;
+}
+
+vector<Posting> PostingList::take_from(size_t first)
+{
+    vector<Posting> postings;
+    uint32_t docs[BLOCK_SIZE];
+    for (size_t b = first; b < blocks_.size(); b++)
+    {
+        size_t count = decode_docs(b, docs);
+        for (size_t i = 0; i < count; i++)
+        {
+            postings.push_back({docs[i], frequency(b, i)});
+        }
+    }
+
+    if (first < blocks_.size())
+    {
+        doc_bytes_.resize(blocks_[first].doc_offset);
+        frequencies_.resize(first * BLOCK_SIZE);
+        blocks_.resize(first);
+        size_ = first * BLOCK_SIZE;
+    }
+    return postings;
+}
+
+void PostingList::append_blocks(const vector<Posting> &postings)
+{
+    uint32_t deltas[BLOCK_SIZE];
+    for (size_t begin = 0; begin < postings.size(); begin += BLOCK_SIZE)
+    {
+        size_t end = min(postings.size(), begin + BLOCK_SIZE);
+        size_t count = end - begin;
+
+        PostingBlock block{postings[end - 1].doc, postings[begin].word_frequency, postings[begin].word_frequency,
+                           static_cast<uint32_t>(doc_bytes_.size()), 0.0f, 0.0f};
+
+        uint32_t previous = blocks_.empty() ? 0 : blocks_.back().last_doc;
+        for (size_t i = begin; i < end; i++)
+        {
+            deltas[i - begin] = postings[i].doc - previous;
+            previous = postings[i].doc;
+            block.max_word_frequency = max(block.max_word_frequency, postings[i].word_frequency);
+            block.min_word_frequency = min(block.min_word_frequency, postings[i].word_frequency);
+        }
+
+        size_t offset = doc_bytes_.size();
+        doc_bytes_.resize(offset + stream_vbyte::max_encoded_bytes(count));
+        doc_bytes_.resize(offset + stream_vbyte::encode(deltas, count, doc_bytes_.data() + offset));
+
+        // linear quantization between the block bounds
+        block.frequency_base = block.min_word_frequency;
+        block.frequency_step = (block.max_word_frequency - block.min_word_frequency) / FREQUENCY_LEVELS;
+        float quantized_max = block.frequency_base;
+        for (size_t i = begin; i < end; i++)
+        {
+            uint16_t level = 0;
+            if (block.frequency_step > 0.0f)
+            {
+                long rounded = lround((postings[i].word_frequency - block.frequency_base) / block.frequency_step);
+                level = static_cast<uint16_t>(min<long>(max<long>(rounded, 0), FREQUENCY_LEVELS));
+            }
+            frequencies_.push_back(level);
+            quantized_max = max(quantized_max, block.frequency_base + level * block.frequency_step);
+        }
+        // scorers see the dequantized values, the block bound has to cover those
+        block.max_word_frequency = quantized_max;
+
+        blocks_.push_back(block);
+        size_ += count;
+    }
+    update_bounds();
+}
+
+void PostingList::update_bounds()
+{
+    // list bounds are the bounds over all blocks
+    max_word_frequency_ = 0.0f;
+    min_word_frequency_ = 0.0f;
+    for (size_t b = 0; b < blocks_.size(); b++)
+    {
+        max_word_frequency_ = (b == 0) ? blocks_[b].max_word_frequency : max(max_word_frequency_, blocks_[b].max_word_frequency);
+        min_word_frequency_ = (b == 0) ? blocks_[b].min_word_frequency : min(min_word_frequency_, blocks_[b].min_word_frequency);
+    }
+}
+
+size_t PostingList::find_block(uint32_t doc) const
+{
+    return lower_bound(blocks_.begin(), blocks_.end(), doc, [](const PostingBlock &block, uint32_t d)
+                       { return block.last_doc < d; }) -
+           blocks_.begin();
+}
+
+void PostingList::add(uint32_t doc, float word_frequency)
+{
+    // new documents get the highest ordinal so this is almost always an append,
+    // which only re-encodes the last block (or starts a new one)
+    if (empty() || max_doc() < doc)
+    {
+        size_t first = size_ % BLOCK_SIZE == 0 ? blocks_.size() : blocks_.size() - 1;
+        vector<Posting> postings = take_from(first);
+        postings.push_back({doc, word_frequency});
+        append_blocks(postings);
+        return;
+    }
+
+    // every block from the one holding doc onwards is re-encoded, an insert shifts them all
+    vector<Posting> postings = take_from(find_block(doc));
+    auto it = lower_bound(postings.begin(), postings.end(), Posting{doc, 0.0f}, doc_less);
+    if (it != postings.end() && it->doc == doc)
+        it->word_frequency = word_frequency;
+    else
+        postings.insert(it, {doc, word_frequency});
+    append_blocks(postings);
+}
+
+bool PostingList::remove(uint32_t doc)
+{
+    size_t b = find_block(doc);
+    if (b == blocks_.size())
+        return false;
+
+    // check the block first so a miss does not re-encode anything
+    uint32_t docs[BLOCK_SIZE];
+    size_t count = decode_docs(b, docs);
+    if (!binary_search(docs, docs + count, doc))
+        return false;
+
+    vector<Posting> postings = take_from(b);
+    postings.erase(lower_bound(postings.begin(), postings.end(), Posting{doc, 0.0f}, doc_less));
+    append_blocks(postings);
+    return true;
+}
+
+size_t PostingList::memory_usage() const
+{
+    return sizeof(PostingList) + doc_bytes_.capacity() + frequencies_.capacity() * sizeof(uint16_t) +
+           blocks_.capacity() * sizeof(PostingBlock);
+}
@@ -0,0 +1,157 @@
+#include "index/score_accumulator.h"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCORE_KERNEL_X86 1
+#endif
+
+using namespace std;
+
+namespace
+{
+    // Both kernels are branch free on the "first touch of this slot" check: a term after
+    // the first hits an unseen document about half the time, which a branch predicts badly.
+    // A fresh slot adds onto 0.0 instead of its stale score, and its ordinal is always
+    // written to touched but only kept (count advanced) when it was fresh.
+
+    // touched gets n spare slots (plus a vector's worth for the AVX2 stores), returns the used size
+    size_t reserve_touched(ScoreAccumulator &acc, size_t n)
+    {
+        size_t count = acc.touched.size();
+        acc.touched.resize(count + n + 4);
+        return count;
+    }
+
+    size_t add_block_scalar(ScoreAccumulator &acc, const uint32_t *docs, const float *word_frequencies, size_t first,
+                            size_t n, double idf, size_t count)
+    {
+        uint32_t *stamps = acc.stamps.data();
+        double *scores = acc.scores.data();
+        uint32_t *touched = acc.touched.data();
+        for (size_t i = first; i < n; i++)
+        {
+            uint32_t doc = docs[i];
+            bool fresh = stamps[doc] != acc.epoch;
+            double score = fresh ? 0.0 : scores[doc];
+            scores[doc] = score + word_frequencies[i] * idf;
+            stamps[doc] = acc.epoch;
+            touched[count] = doc;
+            count += fresh;
+        }
+        return count;
+    }
+
+#ifdef SCORE_KERNEL_X86
+    // for every 4 bit mask of fresh lanes: pshufb mask moving those lanes' ordinals to the front
+    struct CompressTable
+    {
+        uint8_t masks[16][16];
+
+        CompressTable()
+        {
+            for (int mask = 0; mask < 16; mask++)
+            {
+                int out = 0;
+                for (int lane = 0; lane < 4; lane++)
+                {
+                    if (mask & (1 << lane))
+                    {
+                        for (int byte = 0; byte < 4; byte++)
+                            masks[mask][4 * out + byte] = 4 * lane + byte;
+                        out++;
+                    }
+                }
+                for (int byte = 4 * out; byte < 16; byte++)
+                    masks[mask][byte] = 0x80;
+            }
+        }
+    };
+
+    const CompressTable compress;
+
+    // Four postings per step: the stamps of the four slots are gathered and compared with
+    // the epoch, the scores are gathered only for the lanes that are current (fresh lanes
+    // read 0.0), added to in one vector op and written back lane by lane since AVX2 has no
+    // scatter. The fresh ordinals are compressed to the front of a vector and appended
+    // to touched with a single store.
+    __attribute__((target("avx2,popcnt")))
+    size_t add_block_avx2(ScoreAccumulator &acc, const uint32_t *docs, const float *word_frequencies, size_t n,
+                          double idf, size_t count)
+    {
+        const __m256d idf4 = _mm256_set1_pd(idf);
+        const __m128i epoch4 = _mm_set1_epi32(static_cast<int>(acc.epoch));
+        const int *stamps = reinterpret_cast<const int *>(acc.stamps.data());
+        double *scores = acc.scores.data();
+        uint32_t *touched = acc.touched.data();
+
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i *>(docs + i));
+            // float -> double is exact, so the products match the scalar kernel bit for bit
+            __m256d contribution = _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(word_frequencies + i)), idf4);
+
+            __m128i current = _mm_cmpeq_epi32(_mm_i32gather_epi32(stamps, index, 4), epoch4);
+            __m256d load_mask = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(current));
+            __m256d sum = _mm256_add_pd(
+                _mm256_mask_i32gather_pd(_mm256_setzero_pd(), scores, index, load_mask, 8), contribution);
+
+            double out[4];
+            _mm256_storeu_pd(out, sum);
+            for (size_t j = 0; j < 4; j++)
+            {
+                scores[docs[i + j]] = out[j];
+                acc.stamps[docs[i + j]] = acc.epoch;
+            }
+
+            int fresh = ~_mm_movemask_ps(_mm_castsi128_ps(current)) & 0xF;
+            __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i *>(compress.masks[fresh]));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(touched + count), _mm_shuffle_epi8(index, shuffle));
+            count += _mm_popcnt_u32(fresh);
+        }
+        return add_block_scalar(acc, docs, word_frequencies, i, n, idf, count);
+    }
+
+    const bool has_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+#endif
+}
+
+void ScoreAccumulator::begin(size_t num_docs)
+{
+    if (scores.size() < num_docs)
+    {
+        scores.resize(num_docs, 0.0);
+        stamps.resize(num_docs, 0);
+    }
+    touched.clear();
+
+    // after wrapping around every old stamp could look current again
+    if (++epoch == 0)
+    {
+        fill(stamps.begin(), stamps.end(), 0);
+        epoch = 1;
+    }
+}
+
+void ScoreAccumulator::add_block(const uint32_t *docs, const float *word_frequencies, size_t n, double idf,
+                                 ScoreKernel kernel)
+{
+    size_t count = reserve_touched(*this, n);
+#ifdef SCORE_KERNEL_X86
+    if (kernel == ScoreKernel::AVX2 && has_avx2)
+        count = add_block_avx2(*this, docs, word_frequencies, n, idf, count);
+    else
+#endif
+        count = add_block_scalar(*this, docs, word_frequencies, 0, n, idf, count);
+    touched.resize(count);
+}
+
+ScoreKernel ScoreAccumulator::best_kernel()
+{
+#ifdef SCORE_KERNEL_X86
+    if (has_avx2)
+        return ScoreKernel::AVX2;
+#endif
+    return ScoreKernel::SCALAR;
+}
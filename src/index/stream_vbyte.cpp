@@ -0,0 +1,117 @@
+#include "index/stream_vbyte.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STREAM_VBYTE_X86 1
+#endif
+
+namespace stream_vbyte
+{
+    namespace
+    {
+        inline uint8_t value_length(uint32_t value)
+        {
+            if (value < (1u << 8))
+                return 1;
+            if (value < (1u << 16))
+                return 2;
+            if (value < (1u << 24))
+                return 3;
+            return 4;
+        }
+
+        // decodes values one at a time, returns the position after the last data byte
+        const uint8_t *decode_scalar(const uint8_t *control, const uint8_t *data, size_t first, size_t n, uint32_t *out)
+        {
+            for (size_t i = first; i < n; i++)
+            {
+                uint8_t length = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+                uint32_t value = 0;
+                memcpy(&value, data, length); // little endian, like the encoder
+                out[i] = value;
+                data += length;
+            }
+            return data;
+        }
+
+#ifdef STREAM_VBYTE_X86
+        // for every control byte: pshufb mask expanding its four values and their total length
+        struct ShuffleTables
+        {
+            uint8_t masks[256][16];
+            uint8_t lengths[256];
+
+            ShuffleTables()
+            {
+                for (int control = 0; control < 256; control++)
+                {
+                    uint8_t offset = 0;
+                    for (int value = 0; value < 4; value++)
+                    {
+                        uint8_t length = ((control >> (2 * value)) & 3) + 1;
+                        for (int byte = 0; byte < 4; byte++)
+                        {
+                            // 0x80 makes pshufb write a zero byte
+                            masks[control][4 * value + byte] = byte < length ? offset + byte : 0x80;
+                        }
+                        offset += length;
+                    }
+                    lengths[control] = offset;
+                }
+            }
+        };
+
+        const ShuffleTables tables;
+
+        __attribute__((target("ssse3")))
+        const uint8_t *decode_ssse3(const uint8_t *control, const uint8_t *data, const uint8_t *buffer_end,
+                                    size_t n, uint32_t *out)
+        {
+            size_t i = 0;
+            // every step loads 16 bytes, stop while that would leave the buffer
+            for (; i + 4 <= n && buffer_end - data >= 16; i += 4)
+            {
+                uint8_t c = control[i / 4];
+                __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+                __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(tables.masks[c]));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_shuffle_epi8(in, mask));
+                data += tables.lengths[c];
+            }
+            return decode_scalar(control, data, i, n, out);
+        }
+
+        const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+#endif
+    }
+
+    size_t encode(const uint32_t *in, size_t n, uint8_t *out)
+    {
+        uint8_t *control = out;
+        uint8_t *data = out + control_bytes(n);
+        memset(control, 0, control_bytes(n));
+
+        for (size_t i = 0; i < n; i++)
+        {
+            uint8_t length = value_length(in[i]);
+            control[i / 4] |= (length - 1) << (2 * (i % 4));
+            memcpy(data, &in[i], length);
+            data += length;
+        }
+        return data - out;
+    }
+
+    size_t decode(const uint8_t *in, const uint8_t *buffer_end, size_t n, uint32_t *out)
+    {
+        const uint8_t *control = in;
+        const uint8_t *data = in + control_bytes(n);
+        const uint8_t *end;
+#ifdef STREAM_VBYTE_X86
+        if (has_ssse3)
+            end = decode_ssse3(control, data, buffer_end, n, out);
+        else
+#endif
+            end = decode_scalar(control, data, 0, n, out);
+        return end - in;
+    }
+}
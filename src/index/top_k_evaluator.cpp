@@ -0,0 +1,322 @@
+#include "index/top_k_evaluator.h"
+#include "index/score_accumulator.h"
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+using namespace std;
+
+namespace
+{
+    thread_local ScoreAccumulator accumulator;
+}
+
+vector<ScoredDoc> TopKEvaluator::exhaustive(const vector<QueryTerm> &terms, size_t top_k)
+{
+    // every ordinal of every list has to fit into the accumulator
+    size_t num_docs = 0;
+    for (const auto &term : terms)
+    {
+        if (!term.postings->empty())
+            num_docs = max(num_docs, static_cast<size_t>(term.postings->max_doc()) + 1);
+    }
+    accumulator.begin(num_docs);
+
+    // term at a time, each document sums its contributions in query term order
+    for (const auto &term : terms)
+    {
+        // postings are decoded block by block straight into the (SIMD) accumulate kernel
+        term.postings->for_each_block([&](const uint32_t *docs, const float *word_frequencies, size_t n)
+                                      { accumulator.add_block(docs, word_frequencies, n, term.idf); });
+    }
+
+    vector<ScoredDoc> ranked;
+    ranked.reserve(accumulator.touched.size());
+    for (uint32_t doc : accumulator.touched)
+    {
+        ranked.push_back({doc, accumulator.scores[doc]});
+    }
+
+    size_t k = min(top_k, ranked.size());
+    partial_sort(ranked.begin(), ranked.begin() + k, ranked.end(), ranks_before);
+    ranked.resize(k);
+    return ranked;
+}
+
+namespace
+{
+    // max-heap on ranking order: top() is the worst of the documents kept so far
+    struct WorstOnTop
+    {
+        bool operator()(const ScoredDoc &a, const ScoredDoc &b) const { return ranks_before(a, b); }
+    };
+
+    class TopKHeap
+    {
+    private:
+        size_t k_;
+        priority_queue<ScoredDoc, vector<ScoredDoc>, WorstOnTop> heap_;
+
+    public:
+        explicit TopKHeap(size_t k) : k_(k) {}
+
+        bool full() const { return heap_.size() >= k_; }
+
+        // score a document has to beat to get in, -inf while the heap is not full yet
+        double threshold() const
+        {
+            return full() ? heap_.top().score : -numeric_limits<double>::infinity();
+        }
+
+        void offer(const ScoredDoc &candidate)
+        {
+            if (!full())
+                heap_.push(candidate);
+            else if (ranks_before(candidate, heap_.top()))
+            {
+                heap_.pop();
+                heap_.push(candidate);
+            }
+        }
+
+        vector<ScoredDoc> sorted()
+        {
+            vector<ScoredDoc> ranked;
+            ranked.reserve(heap_.size());
+            while (!heap_.empty())
+            {
+                ranked.push_back(heap_.top());
+                heap_.pop();
+            }
+            reverse(ranked.begin(), ranked.end());
+            return ranked;
+        }
+    };
+
+    // largest contribution any posting of the term can make. Bounds are clamped at zero
+    // (a negative idf can only lower a score) and inflated slightly so that summing them
+    // in a different order than the real score can never round below it.
+    double score_upper_bound(float max_word_frequency, float min_word_frequency, double idf)
+    {
+        double bound = max(max_word_frequency * idf, min_word_frequency * idf);
+        return bound > 0.0 ? bound * (1.0 + 1e-9) : 0.0;
+    }
+
+    double score_upper_bound(const QueryTerm &term)
+    {
+        return score_upper_bound(term.postings->max_word_frequency(), term.postings->min_word_frequency(), term.idf);
+    }
+
+    struct WandCursor
+    {
+        PostingList::Cursor cursor;
+        double upper_bound;
+        size_t term; // position in the query, scores are summed in this order
+    };
+
+    // keeps the cursors ordered by their current document (query lists are tiny). Only
+    // pointers are moved, a cursor carries a whole decoded block.
+    void sort_by_doc(vector<WandCursor *> &cursors)
+    {
+        for (size_t i = 1; i < cursors.size(); i++)
+        {
+            for (size_t j = i; j > 0 && cursors[j]->cursor.doc() < cursors[j - 1]->cursor.doc(); j--)
+                swap(cursors[j], cursors[j - 1]);
+        }
+    }
+
+    // first cursor at which the summed bounds could beat the threshold, moved on to the
+    // last cursor sitting on the same document. cursors.size() if there is none.
+    size_t find_pivot(const vector<WandCursor *> &cursors, double threshold)
+    {
+        double bound_sum = 0.0;
+        for (size_t i = 0; i < cursors.size(); i++)
+        {
+            uint32_t doc = cursors[i]->cursor.doc();
+            if (doc == PostingList::END)
+                break;
+            bound_sum += cursors[i]->upper_bound;
+            if (bound_sum > threshold)
+            {
+                while (i + 1 < cursors.size() && cursors[i + 1]->cursor.doc() == doc)
+                    i++;
+                return i;
+            }
+        }
+        return cursors.size();
+    }
+
+    // scores doc (all cursors on it, summed in query term order) and moves those cursors on
+    void score_and_advance(vector<WandCursor *> &cursors, const vector<QueryTerm> &terms,
+                           uint32_t doc, vector<const WandCursor *> &matching, TopKHeap &heap)
+    {
+        matching.clear();
+        for (const WandCursor *c : cursors)
+        {
+            if (c->cursor.doc() == doc)
+                matching.push_back(c);
+        }
+        sort(matching.begin(), matching.end(), [](const WandCursor *a, const WandCursor *b)
+             { return a->term < b->term; });
+
+        double score = 0.0;
+        for (const WandCursor *c : matching)
+        {
+            score += c->cursor.word_frequency() * terms[c->term].idf;
+        }
+        heap.offer({doc, score});
+
+        for (WandCursor *c : cursors)
+        {
+            if (c->cursor.doc() == doc)
+                c->cursor.next();
+        }
+    }
+
+    // opens a cursor for every non-empty term in storage, returns pointers to them for sorting
+    vector<WandCursor *> open_cursors(const vector<QueryTerm> &terms, vector<WandCursor> &storage)
+    {
+        storage.clear();
+        storage.reserve(terms.size()); // pointers below must stay valid
+        for (size_t i = 0; i < terms.size(); i++)
+        {
+            if (!terms[i].postings->empty())
+                storage.push_back({terms[i].postings->cursor(), score_upper_bound(terms[i]), i});
+        }
+
+        vector<WandCursor *> cursors;
+        for (auto &c : storage)
+            cursors.push_back(&c);
+        return cursors;
+    }
+}
+
+vector<ScoredDoc> TopKEvaluator::wand(const vector<QueryTerm> &terms, size_t top_k)
+{
+    if (top_k == 0)
+        return {};
+    TopKHeap heap(top_k);
+
+    vector<WandCursor> storage;
+    vector<WandCursor *> cursors = open_cursors(terms, storage);
+    vector<const WandCursor *> matching;
+
+    while (true)
+    {
+        sort_by_doc(cursors);
+
+        size_t pivot = find_pivot(cursors, heap.threshold());
+        if (pivot == cursors.size())
+            break; // no remaining document can make it into the top-k
+
+        uint32_t pivot_doc = cursors[pivot]->cursor.doc();
+
+        if (cursors[0]->cursor.doc() == pivot_doc)
+        {
+            // every cursor up to the pivot sits on pivot_doc, score it completely
+            score_and_advance(cursors, terms, pivot_doc, matching, heap);
+        }
+        else
+        {
+            // documents before the pivot cannot make it, skip the lagging lists ahead
+            for (size_t i = 0; i < pivot; i++)
+            {
+                cursors[i]->cursor.next_geq(pivot_doc);
+            }
+        }
+    }
+
+    return heap.sorted();
+}
+
+vector<ScoredDoc> TopKEvaluator::block_max_wand(const vector<QueryTerm> &terms, size_t top_k)
+{
+    if (top_k == 0)
+        return {};
+    TopKHeap heap(top_k);
+
+    vector<WandCursor> storage;
+    vector<WandCursor *> cursors = open_cursors(terms, storage);
+    vector<const WandCursor *> matching;
+
+    while (true)
+    {
+        sort_by_doc(cursors);
+
+        double threshold = heap.threshold();
+        size_t pivot = find_pivot(cursors, threshold);
+        if (pivot == cursors.size())
+            break;
+
+        uint32_t pivot_doc = cursors[pivot]->cursor.doc();
+
+        // second, tighter check with the maxima of the blocks that may hold pivot_doc
+        double block_bound_sum = 0.0;
+        for (size_t i = 0; i <= pivot; i++)
+        {
+            WandCursor *c = cursors[i];
+            c->cursor.shallow_next_geq(pivot_doc);
+            const PostingBlock &block = c->cursor.shallow_block();
+            block_bound_sum += score_upper_bound(block.max_word_frequency, block.min_word_frequency, terms[c->term].idf);
+        }
+
+        if (block_bound_sum > threshold)
+        {
+            if (cursors[0]->cursor.doc() == pivot_doc)
+            {
+                score_and_advance(cursors, terms, pivot_doc, matching, heap);
+            }
+            else
+            {
+                for (size_t i = 0; i < pivot; i++)
+                {
+                    cursors[i]->cursor.next_geq(pivot_doc);
+                }
+            }
+        }
+        else
+        {
+            // nothing up to the end of the shortest of these blocks can make it
+            // (nor anything before the next list's current document), jump past it
+            uint64_t next_doc = PostingList::END;
+            for (size_t i = 0; i <= pivot; i++)
+            {
+                next_doc = min<uint64_t>(next_doc, static_cast<uint64_t>(cursors[i]->cursor.shallow_block().last_doc) + 1);
+            }
+            if (pivot + 1 < cursors.size())
+                next_doc = min<uint64_t>(next_doc, cursors[pivot + 1]->cursor.doc());
+
+            for (size_t i = 0; i <= pivot; i++)
+            {
+                cursors[i]->cursor.next_geq(static_cast<uint32_t>(next_doc));
+            }
+        }
+    }
+
+    return heap.sorted();
+}
+
+vector<ScoredDoc> TopKEvaluator::evaluate(const vector<QueryTerm> &terms, size_t top_k, TopKStrategy strategy)
+{
+    switch (strategy)
+    {
+    case TopKStrategy::WAND:
+        return wand(terms, top_k);
+    case TopKStrategy::BLOCK_MAX_WAND:
+        return block_max_wand(terms, top_k);
+    case TopKStrategy::EXHAUSTIVE:
+    default:
+        return exhaustive(terms, top_k);
+    }
+}
+
+TopKStrategy parse_top_k_strategy(const string &name, TopKStrategy def)
+{
+    if (name == "exhaustive")
+        return TopKStrategy::EXHAUSTIVE;
+    if (name == "wand")
+        return TopKStrategy::WAND;
+    if (name == "block_max_wand")
+        return TopKStrategy::BLOCK_MAX_WAND;
+    return def;
+}
@@ -0,0 +1,149 @@
+#include "models/document_frequencies.h"
+#include <cerrno>
+
+using namespace std;
+
+namespace
+{
+    timespec now()
+    {
+        timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return t;
+    }
+
+    timespec plus_ms(timespec t, long ms)
+    {
+        t.tv_sec += ms / 1000;
+        t.tv_nsec += (ms % 1000) * 1000000;
+        if (t.tv_nsec >= 1000000000)
+        {
+            t.tv_sec++;
+            t.tv_nsec -= 1000000000;
+        }
+        return t;
+    }
+
+    bool before(const timespec &a, const timespec &b)
+    {
+        return a.tv_sec < b.tv_sec || (a.tv_sec == b.tv_sec && a.tv_nsec < b.tv_nsec);
+    }
+}
+
+DocumentFrequencies::DocumentFrequencies()
+{
+    pthread_mutex_init(&mutex_, nullptr);
+
+    // timed waits measure against the monotonic clock, wall clock jumps cannot stall them
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&changed_cond_, &attr);
+    pthread_condattr_destroy(&attr);
+
+    first_change_ = now();
+}
+
+DocumentFrequencies::~DocumentFrequencies()
+{
+    pthread_cond_destroy(&changed_cond_);
+    pthread_mutex_destroy(&mutex_);
+}
+
+void DocumentFrequencies::mark_changed()
+{
+    if (!changed_)
+        first_change_ = now();
+    changed_ = true;
+    changes_++;
+    pthread_cond_signal(&changed_cond_);
+}
+
+void DocumentFrequencies::load(const vector<IDFStats> &stats, int total_documents)
+{
+    unordered_map<string, int> counts;
+    counts.reserve(stats.size());
+    for (const auto &s : stats)
+        counts[s.word] = s.document_count;
+
+    pthread_mutex_lock(&mutex_);
+    counts_.swap(counts);
+    total_documents_ = total_documents;
+    mark_changed();
+    pthread_mutex_unlock(&mutex_);
+}
+
+void DocumentFrequencies::add_document(const vector<string> &words)
+{
+    pthread_mutex_lock(&mutex_);
+    for (const auto &word : words)
+        counts_[word]++;
+    total_documents_++;
+    mark_changed();
+    pthread_mutex_unlock(&mutex_);
+}
+
+void DocumentFrequencies::remove_document(const vector<string> &words)
+{
+    pthread_mutex_lock(&mutex_);
+    for (const auto &word : words)
+    {
+        // a word whose last document is gone no longer occurs
+        auto it = counts_.find(word);
+        if (it != counts_.end() && --it->second <= 0)
+            counts_.erase(it);
+    }
+    if (total_documents_ > 0)
+        total_documents_--;
+    mark_changed();
+    pthread_mutex_unlock(&mutex_);
+}
+
+bool DocumentFrequencies::wait_for_changes(long debounce_ms, long max_delay_ms, vector<IDFStats> &stats,
+                                           int &total_documents, long idle_timeout_ms)
+{
+    pthread_mutex_lock(&mutex_);
+    // idle: no timeout unless asked for, nothing runs until the next write
+    if (idle_timeout_ms < 0)
+    {
+        while (!changed_)
+            pthread_cond_wait(&changed_cond_, &mutex_);
+    }
+    else
+    {
+        timespec idle_deadline = plus_ms(now(), idle_timeout_ms);
+        int rc = 0;
+        while (!changed_ && rc != ETIMEDOUT)
+            rc = pthread_cond_timedwait(&changed_cond_, &mutex_, &idle_deadline);
+        if (!changed_)
+        {
+            pthread_mutex_unlock(&mutex_);
+            return false;
+        }
+    }
+
+    // wait for a pause of debounce_ms, every write restarts it, up to the staleness bound
+    timespec latest = plus_ms(first_change_, max_delay_ms);
+    while (true)
+    {
+        uint64_t seen = changes_;
+        timespec quiet = plus_ms(now(), debounce_ms);
+        timespec deadline = before(quiet, latest) ? quiet : latest;
+
+        int rc = 0;
+        while (changes_ == seen && rc != ETIMEDOUT)
+            rc = pthread_cond_timedwait(&changed_cond_, &mutex_, &deadline);
+
+        if (changes_ == seen || !before(now(), latest))
+            break;
+    }
+
+    stats.clear();
+    stats.reserve(counts_.size());
+    for (const auto &[word, count] : counts_)
+        stats.push_back({word, count});
+    total_documents = total_documents_;
+    changed_ = false;
+    pthread_mutex_unlock(&mutex_);
+    return true;
+}
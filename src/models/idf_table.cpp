@@ -1,52 +1,58 @@
 #include "models/idf_table.h"
-#include <iostream>
+#include "utils/logger.h"
 
 using namespace std;
 
-// constructor will initialize the mutex
+// constructor will initialize the mutex, readers start out with an empty table
 IDFTable::IDFTable()
+    : snapshot_(new Snapshot())
 {
-    pthread_mutex_init(&mutex_, nullptr);
+    pthread_mutex_init(&publish_mutex_, nullptr);
 }
 
 // destorying mutex on deletion of IDFTable
 IDFTable::~IDFTable()
 {
-    pthread_mutex_destroy(&mutex_);
+    delete snapshot_.load();
+    pthread_mutex_destroy(&publish_mutex_);
 }
 
 double IDFTable::get_idf(const string &word)
 {
-    // acquire the lock
-    pthread_mutex_lock(&mutex_);
-    double result = 0.0;
-    try
-    {
-        auto it = idf_map_.find(word);
-        if (it != idf_map_.end())
-        {
-            result = it->second;
-        }
-    }
-    catch (const exception &e)
-    {
-        cerr << "Error while getting value from IDF " << e.what() << endl;
-    }
-    pthread_mutex_unlock(&mutex_);
-    return result;
+    // the table stays alive until the guard is released
+    EpochDomain::Guard guard(epochs_);
+    const Snapshot *current = snapshot_.load(memory_order_seq_cst);
+
+    auto it = current->find(word);
+    return it != current->end() ? it->second : 0.0;
 }
 
-void IDFTable::set_idf(const string &word, double value)
+size_t IDFTable::size()
 {
-    pthread_mutex_lock(&mutex_);
+    EpochDomain::Guard guard(epochs_);
+    return snapshot_.load(memory_order_seq_cst)->size();
+}
+
+void IDFTable::publish(unordered_map<string, double> idfs)
+{
+    const Snapshot *next = new Snapshot(move(idfs));
+
+    pthread_mutex_lock(&publish_mutex_);
     try
     {
-        // update if words exists else add it;
-        idf_map_[word] = value;
+        const Snapshot *previous = snapshot_.exchange(next, memory_order_seq_cst);
+
+        // refreshes mostly recompute the same values, those keep cached results valid
+        if (*previous != *next)
+            generation_.fetch_add(1, memory_order_release);
+
+        // readers that loaded the previous table before the swap may still use it
+        epochs_.retire([previous]
+                       { delete previous; });
     }
     catch (const exception &e)
     {
-        cerr << "Error in setting IDF:" << e.what() << endl;
+        LOG_ERROR("Error in publishing IDF table:" << e.what());
     }
-    pthread_mutex_unlock(&mutex_);
-}
\ No newline at end of file
+    pthread_mutex_unlock(&publish_mutex_);
+}
@@ -3,9 +3,18 @@
 #include "controller/document_controller.h"
 #include "controller/search_controller.h"
 #include "db/connection_pool.h"
+#include "db/connection_handle.h"
+#include "db/async_executor.h"
 #include <cstring>
 #include "models/idf_table.h"
 #include "utils/idf_updater.h"
+#include "index/inverted_index.h"
+#include "index/impact_index.h"
+#include "db/term_frequency_repository.h"
+#include "db/document_repository.h"
+#include "models/document_frequencies.h"
+#include "service/ingest_queue.h"
+#include "utils/logger.h"
 #include <dotenv.h>
 
 using namespace std;
@@ -15,41 +24,106 @@ int main() {
     {
         dotenv::init("../.env");
 
+        // per request lines are debug, LOG_LEVEL=debug shows them
+        Logger::set_level(Logger::parse_level(dotenv::getenv("LOG_LEVEL", "info"), LogLevel::Info));
+
         // Initialize connection pool
         ConnectionPool *db_pool = nullptr;
 
         try
         {
-            cout << dotenv::getenv("CONNECTION_POOL_SIZE") << endl;
             std::string pool_size_str = dotenv::getenv("CONNECTION_POOL_SIZE");
             int pool_size = std::stoi(pool_size_str);
-            db_pool = new ConnectionPool(pool_size, dotenv::getenv("DATABASE_NAME"), dotenv::getenv("USERNAME"), dotenv::getenv("PASSWORD"));
+            // CONNECTION_POOL_SIZE connections stay open, bursts may grow the pool up to
+            // CONNECTION_POOL_MAX_SIZE; a request waits at most POOL_ACQUIRE_TIMEOUT_MS for one
+            int pool_max_size = std::stoi(dotenv::getenv("CONNECTION_POOL_MAX_SIZE", pool_size_str));
+            db_pool = new ConnectionPool(pool_size, pool_max_size, dotenv::getenv("DATABASE_NAME"), dotenv::getenv("USERNAME"), dotenv::getenv("PASSWORD"),
+                                         std::stol(dotenv::getenv("POOL_ACQUIRE_TIMEOUT_MS", "5000")),
+                                         std::stol(dotenv::getenv("POOL_IDLE_TIMEOUT_MS", "60000")),
+                                         std::stol(dotenv::getenv("POOL_HEALTH_CHECK_MS", "10000")));
         }
         catch (const std::exception &e)
         {
-            cerr << "Failed to create DB connection pool: " << e.what() << endl;
+            LOG_ERROR("Failed to create DB connection pool: " << e.what());
             return 1;
         }
 
+        // document frequencies are loaded once, from here on the write path keeps them current
+        {
+            ConnectionHandle db_handle(db_pool);
+            TermFrequencyRepository tf_repo(&db_handle);
+            DocumentRepository doc_repo(&db_handle);
+
+            int total_documents = doc_repo.get_total_documents();
+            vector<IDFStats> frequencies = tf_repo.get_document_frequencies();
+            // databases created before word_df existed are counted once
+            if (frequencies.empty() && total_documents > 0 && tf_repo.backfill_document_frequencies())
+                frequencies = tf_repo.get_document_frequencies();
+
+            DocumentFrequencies::instance().load(frequencies, total_documents);
+        }
+
+        // optionally keep the whole inverted index in memory so searches never touch the db
+        InvertedIndex *index = nullptr;
+        if (dotenv::getenv("IN_MEMORY_INDEX", "false") == "true")
+        {
+            index = new InvertedIndex();
+
+            ConnectionHandle db_handle(db_pool);
+            TermFrequencyRepository tf_repo(&db_handle);
+            index->load(tf_repo.get_all_term_frequencies());
+        }
+
+        // optionally rank with precomputed, quantized tf-idf impacts (needs the in-memory index),
+        // rebuilt by the IDF updater after every refresh
+        ImpactIndex *impacts = nullptr;
+        if (index && dotenv::getenv("IMPACT_INDEX", "false") == "true")
+        {
+            impacts = new ImpactIndex(std::stoi(dotenv::getenv("IMPACT_BITS", "8")));
+        }
+
         // initializing a global idf_table which will be used everywhere
         IDFTable global_idf_table;
 
         // initializing thread for background processing
         pthread_t idf_thread;
 
-        if (pthread_create(&idf_thread, nullptr, idf_updater_thread, &global_idf_table) != 0)
+        IDFUpdaterArgs idf_args{&global_idf_table, index, impacts};
+        if (pthread_create(&idf_thread, nullptr, idf_updater_thread, &idf_args) != 0)
         {
-            cerr << "Unable to start IDF updater thread\n";
+            LOG_ERROR("Unable to start IDF updater thread");
             return 1;
         }
 
         // Detach the thread
         pthread_detach(idf_thread);
 
+        // optionally batch concurrent creates into group commits (INGEST_WRITERS > 0)
+        IngestQueue *ingest = nullptr;
+        int ingest_writers = std::stoi(dotenv::getenv("INGEST_WRITERS", "0"));
+        if (ingest_writers > 0)
+        {
+            ingest = new IngestQueue(db_pool, index, ingest_writers,
+                                     std::stoul(dotenv::getenv("INGEST_QUEUE_CAPACITY", "1024")),
+                                     std::stoul(dotenv::getenv("INGEST_BATCH_SIZE", "64")),
+                                     std::stol(dotenv::getenv("INGEST_LINGER_MS", "5")));
+        }
+
+        // optionally run the request reads on a few pipelined non-blocking connections
+        // (ASYNC_DB_THREADS > 0) instead of a pooled connection each
+        AsyncExecutor *async_db = nullptr;
+        int async_threads = std::stoi(dotenv::getenv("ASYNC_DB_THREADS", "0"));
+        if (async_threads > 0)
+        {
+            async_db = new AsyncExecutor(async_threads, std::stoi(dotenv::getenv("ASYNC_DB_CONNECTIONS", "2")),
+                                         dotenv::getenv("DATABASE_NAME"), dotenv::getenv("USERNAME"),
+                                         dotenv::getenv("PASSWORD"));
+        }
+
         // initializing document_handler for handling all incoming requests
-        DocumentController doc_handler(db_pool);
+        DocumentController doc_handler(db_pool, index, ingest, async_db);
 
-        SearchController search_handler(db_pool, &global_idf_table);
+        SearchController search_handler(db_pool, &global_idf_table, index, impacts, async_db);
 
         // can configure number of threads here.
         vector<string> cpp_options = {
@@ -61,13 +135,15 @@ int main() {
         server.addHandler("/documents", doc_handler);
         server.addHandler("/search", search_handler);
 
+        // startup lines logged so far come before the prompt
+        Logger::instance().flush();
         cout << "Server running on port" << dotenv::getenv("PORT") << endl;
         cout << "Press Enter to stop.\n";
         getchar();
     }
     catch (const std::exception &e)
     {
-        cerr << "An exception ouccred while trying to start the server " << e.what() << endl;
+        LOG_ERROR("An exception ouccred while trying to start the server " << e.what());
         return 1;
     }
 
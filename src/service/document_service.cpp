@@ -1,15 +1,120 @@
 #include "service/document_service.h"
 #include "utils/cache_manager.h"
-#include <iostream>
+#include "index/doc_id_dictionary.h"
+#include "models/document_frequencies.h"
+#include "utils/logger.h"
+#include <memory>
+#include <dotenv.h>
 
 using namespace std;
 
+// times a write retries patching a cached list that other writes keep replacing
+static const int PATCH_ATTEMPTS = 3;
+
+void DocumentService::patch_term_cache(const string &doc_id, const vector<TermFrequency> &term_freqs, bool added)
+{
+    auto &tf_cache = CacheManager::termFrequencyCache();
+    auto &dictionary = DocIdDictionary::instance();
+
+    optional<uint32_t> ordinal = added ? dictionary.get_or_assign(doc_id) : dictionary.find(doc_id);
+    if (!ordinal)
+        return;
+
+    for (const auto &tf : term_freqs)
+    {
+        // bumped before patching: a reader that fetched this word from the db before the
+        // commit either caches its list before the patch below (and gets it patched) or
+        // sees the new generation and drops its stale list
+        CacheManager::termChanged(tf.word);
+
+        // cached lists are shared with readers, so the patch goes into a copy. The copy is
+        // O(list length), so it is built outside the shard lock and swapped in only if no
+        // other write replaced the list meanwhile, otherwise it is redone on that one
+        bool patched = false;
+        for (int attempt = 0; attempt < PATCH_ATTEMPTS && !patched; attempt++)
+        {
+            shared_ptr<const PostingList> cached = tf_cache.peek(tf.word);
+            if (!cached)
+            {
+                patched = true; // not cached, nothing to patch
+                break;
+            }
+
+            auto copy = make_shared<PostingList>(*cached);
+            if (added)
+                copy->add(*ordinal, tf.word_frequency);
+            else
+                copy->remove(*ordinal);
+            patched = tf_cache.replace_if(tf.word, cached, move(copy));
+        }
+
+        // lost every race against other writes of this word, the next search reloads it
+        if (!patched)
+            tf_cache.remove(tf.word);
+    }
+}
+
+// DB_PIPELINE=true sends the whole create transaction in one flight
+static bool pipeline_writes()
+{
+    static const bool enabled = dotenv::getenv("DB_PIPELINE", "false") == "true";
+    return enabled;
+}
+
+void DocumentService::apply_created(const string &doc_id, const vector<TermFrequency> &term_freqs, const vector<string> &words)
+{
+    // postings become visible to the in-memory index only once they are durable
+    if (index_)
+        index_->add_document(doc_id, term_freqs);
+
+    DocumentFrequencies::instance().add_document(words);
+
+    // cached postings of the document's words gain it, other cached words stay warm
+    patch_term_cache(doc_id, term_freqs, true);
+
+    // cached query results may now be missing this document
+    CacheManager::corpusChanged();
+}
+
+optional<string> DocumentService::create_document_pipelined(const string &text)
+{
+    if (!db_->begin_pipeline())
+        return {};
+
+    // the three statements are only queued here, end_pipeline sends them with a single
+    // sync and they commit (or roll back) together as its implicit transaction
+    auto doc_id = doc_repo_->send_create_document(text);
+    vector<TermFrequency> term_freqs;
+    vector<string> words;
+    bool sent = doc_id.has_value();
+    if (sent)
+    {
+        term_freqs = Tokenizer::tokenize_and_compute(*doc_id, text);
+        for (const auto &tf : term_freqs)
+            words.push_back(tf.word);
+        sent = tf_repo_->send_insert_term_frequencies(term_freqs) &&
+               tf_repo_->send_increment_document_frequencies(words);
+    }
+
+    // always ends the pipeline, a statement that failed rolled back the others
+    if (!db_->end_pipeline() || !sent)
+        return {};
+
+    CacheManager::documentCache().put(doc_id.value(), text);
+    apply_created(doc_id.value(), term_freqs, words);
+    return doc_id;
+}
+
 optional<string> DocumentService::create_document(const string &text)
 {
     try
     {
+        if (pipeline_writes())
+            return create_document_pipelined(text);
+
         // to handle multiple database inserts, using transaction to ensure atomicity
-        db_->begin_transaction();
+        if (!db_->begin_transaction())
+            return {};
 
         // insert into document table
         auto doc_id = doc_repo_->create_document(text);
@@ -28,21 +133,92 @@ optional<string> DocumentService::create_document(const string &text)
             return {};
         }
 
+        // document frequencies change in the same transaction, term_freqs holds distinct words
+        vector<string> words;
+        for (const auto &tf : term_freqs)
+            words.push_back(tf.word);
+        if (!tf_repo_->increment_document_frequencies(words))
+        {
+            db_->rollback();
+            return {};
+        }
+
         auto &doc_cache = CacheManager::documentCache();
 
         // adding doc to cache
         if (doc_id.has_value())
         {
             doc_cache.put(doc_id.value(), text);
-            cout << "Added to cache!" << endl;
+            LOG_DEBUG("Added to cache!");
         }
 
-        db_->commit();
+        if (!db_->commit())
+            return {};
+
+        apply_created(doc_id.value(), term_freqs, words);
         return doc_id;
     }
     catch (const exception &e)
     {
-        cerr << "Exception in create_document: " << e.what() << endl;
+        LOG_ERROR("Exception in create_document: " << e.what());
+        return nullopt;
+    }
+}
+
+optional<vector<string>> DocumentService::create_documents(const vector<string> &texts)
+{
+    try
+    {
+        // the whole batch is one transaction: one COPY for the documents, one for all
+        // their term frequencies and one word_df update
+        if (!db_->begin_transaction())
+            return {};
+
+        auto doc_ids = doc_repo_->create_documents_bulk(texts);
+        if (!doc_ids)
+        {
+            db_->rollback();
+            return {};
+        }
+
+        vector<vector<TermFrequency>> doc_term_freqs;
+        vector<TermFrequency> term_freqs;
+        vector<string> words;
+        for (size_t i = 0; i < texts.size(); i++)
+        {
+            doc_term_freqs.push_back(Tokenizer::tokenize_and_compute((*doc_ids)[i], texts[i]));
+            for (const auto &tf : doc_term_freqs.back())
+            {
+                term_freqs.push_back(tf);
+                words.push_back(tf.word);
+            }
+        }
+
+        if (!tf_repo_->insert_term_frequencies_bulk(term_freqs) || !tf_repo_->increment_document_frequencies(words))
+        {
+            db_->rollback();
+            return {};
+        }
+
+        if (!db_->commit())
+            return {};
+
+        auto &doc_cache = CacheManager::documentCache();
+        for (size_t i = 0; i < texts.size(); i++)
+        {
+            doc_cache.put((*doc_ids)[i], texts[i]);
+
+            vector<string> doc_words;
+            for (const auto &tf : doc_term_freqs[i])
+                doc_words.push_back(tf.word);
+            apply_created((*doc_ids)[i], doc_term_freqs[i], doc_words);
+        }
+
+        return doc_ids;
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Exception in create_documents: " << e.what());
         return nullopt;
     }
 }
@@ -56,12 +232,12 @@ optional<Document> DocumentService::get_document_by_id(const string &doc_id)
 
         // trying to retrieve from cache
         auto result = doc_cache.get(doc_id);
-        if (result.has_value())
+        if (result)
         {
-            cout << "Returned from cache!" << endl;
+            LOG_DEBUG("Returned from cache!");
             Document doc;
             doc.doc_id = doc_id;
-            doc.document_text = result.value();
+            doc.document_text = *result;
             return doc; // returns the string directly
         }
         // if it doesn't then retireve from database
@@ -69,7 +245,7 @@ optional<Document> DocumentService::get_document_by_id(const string &doc_id)
     }
     catch (const exception &e)
     {
-        cerr << "Exception in get_document_by_id: " << e.what() << endl;
+        LOG_ERROR("Exception in get_document_by_id: " << e.what());
         return nullopt;
     }
 }
@@ -80,23 +256,50 @@ bool DocumentService::delete_document_by_id(const string &doc_id)
     {
         // delete it from cache if it exists
         auto &doc_cache = CacheManager::documentCache();
+        doc_cache.remove(doc_id);
 
-        bool isPresent = doc_cache.remove(doc_id);
+        // document frequencies are counted down in the same transaction, before the
+        // delete cascades to the document's term_frequency rows
+        if (!db_->begin_transaction())
+            return false;
 
-        // if present in cache then also remove all the words in that document from cache
-        if (isPresent)
+        auto words = tf_repo_->decrement_document_frequencies(doc_id);
+        if (!words)
         {
-            auto &tf_cache = CacheManager::termFrequencyCache();
-            // clearing the cache here is simpler than removing those targeted docs
-            cout << "Cache cleared!" << endl;
-            tf_cache.clear();
+            db_->rollback();
+            return false;
+        }
+
+        bool deleted = doc_repo_->delete_document(doc_id);
+        if (!deleted)
+        {
+            db_->rollback();
+            return false;
         }
 
-        return doc_repo_->delete_document(doc_id);
+        if (!db_->commit())
+            return false;
+
+        // term_frequency rows are removed by ON DELETE CASCADE, mirror that in memory
+        if (index_)
+            index_->remove_document(doc_id);
+
+        DocumentFrequencies::instance().remove_document(*words);
+
+        // only the posting lists of the document's own words lose it
+        vector<TermFrequency> term_freqs;
+        for (const auto &word : *words)
+            term_freqs.push_back({doc_id, word, 0.0f});
+        patch_term_cache(doc_id, term_freqs, false);
+
+        // cached query results may still rank the deleted document
+        CacheManager::corpusChanged();
+
+        return true;
     }
     catch (const exception &e)
     {
-        cerr << "Exception in delete_document_by_id: " << e.what() << endl;
+        LOG_ERROR("Exception in delete_document_by_id: " << e.what());
         return false;
     }
 }
@@ -0,0 +1,224 @@
+#include "service/ingest_queue.h"
+#include "service/document_service.h"
+#include "utils/logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+    timespec now()
+    {
+        timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        return t;
+    }
+
+    timespec plus_ms(timespec t, long ms)
+    {
+        t.tv_sec += ms / 1000;
+        t.tv_nsec += (ms % 1000) * 1000000;
+        if (t.tv_nsec >= 1000000000)
+        {
+            t.tv_sec++;
+            t.tv_nsec -= 1000000000;
+        }
+        return t;
+    }
+
+    long elapsed_us(const timespec &start)
+    {
+        timespec end = now();
+        return (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000;
+    }
+}
+
+IngestQueue::IngestQueue(ConnectionPool *db_pool, InvertedIndex *index, int writers, size_t capacity,
+                         size_t max_batch, long linger_ms)
+    : db_pool_(db_pool), index_(index), capacity_(capacity), max_batch_(max_batch), linger_ms_(linger_ms)
+{
+    pthread_mutex_init(&mutex_, nullptr);
+    pthread_mutex_init(&stats_mutex_, nullptr);
+    window_.since = now();
+
+    // the linger deadline is measured against the monotonic clock
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&not_empty_, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&not_full_, nullptr);
+    pthread_cond_init(&done_, nullptr);
+
+    for (int i = 0; i < writers; i++)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, nullptr, writer_thread, this) != 0)
+            throw runtime_error("Unable to start ingest writer thread");
+        pthread_detach(thread);
+    }
+
+    LOG_INFO("Ingest queue started: " << writers << " writers, batches of up to " << max_batch
+          << ", linger " << linger_ms << " ms");
+}
+
+IngestQueue::~IngestQueue()
+{
+    // writers are detached and live as long as the server, like the IDF updater
+    pthread_cond_destroy(&done_);
+    pthread_cond_destroy(&not_full_);
+    pthread_cond_destroy(&not_empty_);
+    pthread_mutex_destroy(&stats_mutex_);
+    pthread_mutex_destroy(&mutex_);
+}
+
+optional<string> IngestQueue::submit(const string &text)
+{
+    Pending pending;
+    pending.text = &text;
+    pending.enqueued = now();
+
+    pthread_mutex_lock(&mutex_);
+    // bounded: a full queue pushes back on the request threads
+    while (queue_.size() >= capacity_)
+        pthread_cond_wait(&not_full_, &mutex_);
+
+    queue_.push_back(&pending);
+    if (queue_.size() == 1 || queue_.size() == max_batch_)
+        pthread_cond_signal(&not_empty_);
+
+    while (!pending.done)
+        pthread_cond_wait(&done_, &mutex_);
+    pthread_mutex_unlock(&mutex_);
+
+    return pending.doc_id;
+}
+
+vector<IngestQueue::Pending *> IngestQueue::take_batch(size_t &depth)
+{
+    pthread_mutex_lock(&mutex_);
+    while (queue_.empty())
+        pthread_cond_wait(&not_empty_, &mutex_);
+
+    // a batch goes once it is full or its oldest document waited linger_ms
+    timespec deadline = plus_ms(queue_.front()->enqueued, linger_ms_);
+    int rc = 0;
+    while (!queue_.empty() && queue_.size() < max_batch_ && rc != ETIMEDOUT)
+        rc = pthread_cond_timedwait(&not_empty_, &mutex_, &deadline);
+
+    vector<Pending *> batch;
+    while (!queue_.empty() && batch.size() < max_batch_)
+    {
+        batch.push_back(queue_.front());
+        queue_.pop_front();
+    }
+    // the rest is another writer's batch
+    if (!queue_.empty())
+        pthread_cond_signal(&not_empty_);
+    depth = queue_.size();
+    pthread_cond_broadcast(&not_full_);
+    pthread_mutex_unlock(&mutex_);
+    return batch;
+}
+
+void IngestQueue::write_batch(const vector<Pending *> &batch, size_t depth)
+{
+    vector<string> texts;
+    for (const auto *pending : batch)
+        texts.push_back(*pending->text);
+
+    vector<optional<string>> doc_ids(batch.size());
+
+    // a pool exhausted for too long fails the batch like a request that got no connection
+    ConnectionHandle db_handle(db_pool_);
+    try
+    {
+        DocumentRepository doc_repo(&db_handle);
+        TermFrequencyRepository tf_repo(&db_handle);
+        DocumentService service(&doc_repo, &tf_repo, &db_handle, index_);
+
+        timespec start = now();
+        auto created = service.create_documents(texts);
+        long commit_us = elapsed_us(start);
+
+        if (created)
+        {
+            for (size_t i = 0; i < batch.size(); i++)
+                doc_ids[i] = (*created)[i];
+
+            uint64_t batches = batches_.fetch_add(1) + 1;
+            uint64_t documents = documents_.fetch_add(batch.size()) + batch.size();
+            uint64_t total_us = commit_us_.fetch_add(commit_us) + commit_us;
+            LOG_DEBUG("Ingest batch of " << batch.size() << " committed in " << commit_us / 1000.0
+                   << " ms, queue depth " << depth << " (average " << static_cast<double>(documents) / batches
+                   << " documents, " << total_us / 1000.0 / batches << " ms over " << batches << " batches)");
+            record_batch(batch.size(), commit_us, depth);
+        }
+        else
+        {
+            // one bad document must not fail the others, retry them one by one
+            LOG_WARN("Ingest batch of " << batch.size() << " failed, creating its documents one by one");
+            for (size_t i = 0; i < batch.size(); i++)
+                doc_ids[i] = service.create_document(texts[i]);
+        }
+    }
+    catch (const exception &e)
+    {
+        LOG_ERROR("Exception in ingest writer thread: " << e.what());
+    }
+
+    // every request of the batch is completed, failed ones without a doc_id
+    pthread_mutex_lock(&mutex_);
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        batch[i]->doc_id = move(doc_ids[i]);
+        batch[i]->done = true;
+    }
+    pthread_cond_broadcast(&done_);
+    pthread_mutex_unlock(&mutex_);
+}
+
+void IngestQueue::record_batch(size_t documents, long commit_us, size_t depth)
+{
+    pthread_mutex_lock(&stats_mutex_);
+    // an idle queue reports nothing, the window starts with the first batch after it
+    if (window_.batches == 0)
+        window_.since = now();
+    window_.batches++;
+    window_.documents += documents;
+    window_.commit_us += commit_us;
+    window_.max_commit_us = max<uint64_t>(window_.max_commit_us, commit_us);
+    window_.max_depth = max(window_.max_depth, depth);
+
+    timespec t = now();
+    long window_ms = (t.tv_sec - window_.since.tv_sec) * 1000L + (t.tv_nsec - window_.since.tv_nsec) / 1000000;
+    if (window_ms < STATS_INTERVAL_MS)
+    {
+        pthread_mutex_unlock(&stats_mutex_);
+        return;
+    }
+    Window done = window_;
+    window_ = Window();
+    window_.since = t;
+    pthread_mutex_unlock(&stats_mutex_);
+
+    LOG_INFO("Ingest: " << done.documents << " documents in " << done.batches << " batches over the last "
+          << window_ms / 1000.0 << " s, average batch " << static_cast<double>(done.documents) / done.batches
+          << ", commit average " << done.commit_us / 1000.0 / done.batches << " ms (max "
+          << done.max_commit_us / 1000.0 << " ms), max queue depth " << done.max_depth);
+}
+
+void *IngestQueue::writer_thread(void *arg)
+{
+    IngestQueue *queue = static_cast<IngestQueue *>(arg);
+    while (true)
+    {
+        size_t depth;
+        auto batch = queue->take_batch(depth);
+        if (!batch.empty())
+            queue->write_batch(batch, depth);
+    }
+    return nullptr;
+}
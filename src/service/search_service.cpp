@@ -1,140 +1,362 @@
 #include "service/search_service.h"
 #include "utils/tokenizer.h"
 #include "utils/cache_manager.h"
+#include "index/doc_id_dictionary.h"
+#include "utils/logger.h"
 #include <algorithm>
-#include <iostream>
+#include <unordered_map>
+#include <dotenv.h>
 
 using namespace std;
 
-SearchService::SearchService(DocumentRepository* doc_repo, TermFrequencyRepository* tf_repo, IDFTable* idf_table)
-    : doc_repo_(doc_repo), tf_repo_(tf_repo), idf_table_(idf_table) {}
+// top-k strategy is read once from the environment, Block-Max WAND unless configured otherwise
+static TopKStrategy configured_top_k_strategy()
+{
+    static const TopKStrategy strategy = parse_top_k_strategy(dotenv::getenv("TOP_K_STRATEGY", "block_max_wand"), TopKStrategy::BLOCK_MAX_WAND);
+    return strategy;
+}
 
-vector<SearchResult> SearchService::search(const string &query, int top_k)
+// key of the query result cache: the normalized tokens and top_k. Tokens never contain
+// spaces or punctuation, so the separators cannot be ambiguous.
+static string result_cache_key(const vector<string> &tokens, int top_k)
 {
-    vector<SearchResult> results;
-    try
+    string key;
+    for (const auto &token : tokens)
     {
-        Tokenizer tokenizer;
-        // tokenize input query
-        auto tokens = tokenizer.tokenize(query);
+        key += token;
+        key += ' ';
+    }
+    key += '#';
+    key += to_string(top_k);
+    return key;
+}
 
-        // if no tokens in the query, return directly
-        if (tokens.empty())
-            return results;
+SearchService::SearchService(DocumentRepository* doc_repo, TermFrequencyRepository* tf_repo, IDFTable* idf_table, InvertedIndex* index, ImpactIndex* impacts)
+    : doc_repo_(doc_repo), tf_repo_(tf_repo), idf_table_(idf_table), index_(index), impacts_(impacts) {}
+
+// fills lists with the posting list of every token (same order, nullptr for unknown words),
+// served from the term frequency cache with a single db query for all missed words. Cached
+// lists are shared with the cache, not copied. False if that query failed.
+bool SearchService::postings_from_cache(const vector<string> &tokens, vector<shared_ptr<const PostingList>> &lists,
+                                        const function<void(const vector<shared_ptr<const PostingList>> &)> &while_fetching)
+{
+    // initialize cache
+    auto &tf_cache = CacheManager::termFrequencyCache();
+
+    lists.assign(tokens.size(), nullptr);
+    vector<string> missed_tokens;
+
+    // checking if it exists in cache or not for each token
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+        auto cached_val = tf_cache.get(tokens[i]);
+
+        // cache hit
+        if (cached_val)
+        {
+            LOG_DEBUG(tokens[i] << " found in cache");
+            lists[i] = move(cached_val);
+        }
+        else // cache miss
+        {
+            missed_tokens.push_back(tokens[i]);
+        }
+    }
+
+    // add tokens into cache
+    if (!missed_tokens.empty())
+    {
+        // generations of the missed words before reading them, see CacheManager::termGeneration
+        unordered_map<string, uint64_t> generations;
+        for (const auto &token : missed_tokens)
+            generations[token] = CacheManager::termGeneration(token);
 
-        // initialize cache
-        auto &tf_cache = CacheManager::termFrequencyCache();
+        // query db for missed tokens, the cached lists are put to use while it runs
+        auto pending = tf_repo_->fetch_word_stats_for_query(missed_tokens);
+        while_fetching(lists);
+        auto db_records = pending.get();
+        if (!db_records)
+            return false;
 
-        vector<TermFrequency> tf_records;
-        vector<string> missed_tokens;
+        // group the rows per word, swapping the UUIDs for ordinals
+        auto &dictionary = DocIdDictionary::instance();
+        unordered_map<string, vector<Posting>> grouped;
+        for (const auto &rec : *db_records)
+        {
+            grouped[rec.word].push_back({dictionary.get_or_assign(rec.doc_id), rec.word_frequency});
+        }
 
-        // checking if it exists in cache or not for each token
-        for (const auto &token : tokens)
+        for (size_t i = 0; i < tokens.size(); i++)
         {
-            auto cached_val = tf_cache.get(token);
+            auto it = grouped.find(tokens[i]);
+            if (it == grouped.end())
+                continue;
+
+            // put the word into cache. A write that committed since the read may have missed
+            // patching it (it was not cached yet), then the list is taken out again.
+            lists[i] = make_shared<const PostingList>(move(it->second));
+            tf_cache.put(tokens[i], lists[i]);
+            if (CacheManager::termGeneration(tokens[i]) != generations[tokens[i]])
+                tf_cache.remove(tokens[i]);
+        }
+    }
+
+    return true;
+}
 
-            // cache hit
-            if (cached_val.has_value())
+// replaces the approximate impact scores of the candidates with exact tf-idf sums from the
+// resident index and re-ranks them. Documents deleted since the last impact rebuild have
+// no postings left and are dropped.
+vector<ScoredDoc> SearchService::rescore(vector<ScoredDoc> candidates, const vector<string> &tokens, const vector<double> &idfs)
+{
+    // visit candidates in ordinal order so every cursor only moves forward
+    sort(candidates.begin(), candidates.end(), [](const ScoredDoc &a, const ScoredDoc &b)
+         { return a.doc < b.doc; });
+
+    vector<ScoredDoc> ranked;
+    index_->with_postings(tokens, [&](const vector<const PostingList *> &lists) {
+        vector<PostingList::Cursor> cursors;
+        vector<double> term_idfs;
+        for (size_t i = 0; i < lists.size(); i++)
+        {
+            if (lists[i])
             {
-                const auto &cached_vec = cached_val.value();
-                cout << token << "found in cache" << endl;
-                for (const auto &pair : cached_vec)
-                {
-                    // converting to required structure
-                    tf_records.push_back({pair.first, token, pair.second});
-                }
+                cursors.push_back(lists[i]->cursor());
+                term_idfs.push_back(idfs[i]);
             }
-            else // cache miss
+        }
+
+        for (const auto &candidate : candidates)
+        {
+            // summed in query term order, like every TopKEvaluator strategy
+            double score = 0.0;
+            bool found = false;
+            for (size_t i = 0; i < cursors.size(); i++)
             {
-                missed_tokens.push_back(token);
+                cursors[i].next_geq(candidate.doc);
+                if (cursors[i].doc() == candidate.doc)
+                {
+                    score += cursors[i].word_frequency() * term_idfs[i];
+                    found = true;
+                }
             }
+            if (found)
+                ranked.push_back({candidate.doc, score});
         }
+    });
 
-        // add tokens into cache
-        if (!missed_tokens.empty())
-        {
-            // query db for missed tokens
-            auto db_records = tf_repo_->get_word_stats_for_query(missed_tokens);
-            tf_records.insert(tf_records.end(), db_records.begin(), db_records.end());
+    sort(ranked.begin(), ranked.end(), ranks_before);
+    return ranked;
+}
 
-            unordered_map<string, vector<pair<string, float>>> temp_cache;
+// ranks the documents for the distinct, sorted query tokens with whichever postings source is configured
+optional<vector<ScoredDoc>> SearchService::rank(const vector<string> &tokens, int top_k,
+                                                const vector<string> &likely, future<vector<Document>> &early_texts)
+{
+    // idf of every query word, looked up before touching any postings
+    vector<double> idfs;
+    for (const auto &token : tokens)
+    {
+        idfs.push_back(idf_table_->get_idf(token));
+    }
 
-            // convert it into required structure for cache
-            for (const auto &rec : db_records)
+    TopKStrategy strategy = configured_top_k_strategy();
+    vector<ScoredDoc> ranked;
+    if (index_ && impacts_ && impacts_->ready())
+    {
+        // integer impact scoring picks the top-k, only those are scored exactly
+        ranked = rescore(impacts_->top_k(tokens, top_k), tokens, idfs);
+    }
+    else if (index_)
+    {
+        // postings are resident in memory, no cache or db round trip needed
+        index_->with_postings(tokens, [&](const vector<const PostingList *> &lists) {
+            vector<QueryTerm> terms;
+            for (size_t i = 0; i < lists.size(); i++)
             {
-                temp_cache[rec.word].push_back(make_pair(rec.doc_id, rec.word_frequency));
+                if (lists[i])
+                    terms.push_back({lists[i], idfs[i]});
             }
+            ranked = TopKEvaluator::evaluate(terms, top_k, strategy);
+        });
+    }
+    else
+    {
+        // The documents ranked highest by the cached words alone, and those of an earlier
+        // ranking of the same query, are the likely top_k. Their texts are read while the
+        // missed words' postings are, which only pays off when both reads are in flight
+        // at once.
+        auto read_likely_texts = [&](const vector<shared_ptr<const PostingList>> &cached) {
+            if (!doc_repo_->overlaps_reads())
+                return;
 
-            // put the word into cache
-            for (auto &[word, vec] : temp_cache)
+            vector<string> doc_ids = likely;
+            vector<QueryTerm> terms;
+            for (size_t i = 0; i < cached.size(); i++)
             {
-                tf_cache.put(word, vec);
+                if (cached[i])
+                    terms.push_back({cached[i].get(), idfs[i]});
+            }
+            if (!terms.empty())
+            {
+                auto &dictionary = DocIdDictionary::instance();
+                for (const auto &scored : TopKEvaluator::evaluate(terms, top_k, strategy))
+                    doc_ids.push_back(dictionary.doc_id(scored.doc));
             }
-        }
 
-        // Map: doc_id -> total TF-IDF score
-        unordered_map<string, double> doc_scores;
+            // peek, a guess is not an access
+            auto &doc_cache = CacheManager::documentCache();
+            sort(doc_ids.begin(), doc_ids.end());
+            doc_ids.erase(unique(doc_ids.begin(), doc_ids.end()), doc_ids.end());
+            vector<string> uncached;
+            for (const auto &doc_id : doc_ids)
+            {
+                if (!doc_cache.peek(doc_id))
+                    uncached.push_back(doc_id);
+            }
+            if (!uncached.empty())
+                early_texts = doc_repo_->fetch_documents_by_ids(uncached);
+        };
 
-        // Precompute IDF for all query tokens
-        unordered_map<string, double> idf_map;
-        for (const auto &token : tokens)
+        vector<shared_ptr<const PostingList>> lists;
+        if (!postings_from_cache(tokens, lists, read_likely_texts))
+            return nullopt;
+        vector<QueryTerm> terms;
+        for (size_t i = 0; i < lists.size(); i++)
         {
-            idf_map[token] = idf_table_->get_idf(token);
+            if (lists[i])
+                terms.push_back({lists[i].get(), idfs[i]});
         }
+        ranked = TopKEvaluator::evaluate(terms, top_k, strategy);
+    }
+    return ranked;
+}
 
-        // Accumulate TF-IDF scores per document
-        for (const auto &rec : tf_records)
+vector<SearchResult> SearchService::search(const string &query, int top_k)
+{
+    vector<SearchResult> results;
+    try
+    {
+        Tokenizer tokenizer;
+        // tokenize input query
+        auto tokens = tokenizer.tokenize(query);
+
+        // if no tokens in the query, return directly
+        if (tokens.empty() || top_k <= 0)
+            return results;
+
+        // scores are averaged over every query word, repeats included, as they always were
+        size_t query_words = tokens.size();
+
+        // a word repeated in the query is scored once, same as the IN (...) lookup did
+        sort(tokens.begin(), tokens.end());
+        tokens.erase(unique(tokens.begin(), tokens.end()), tokens.end());
+
+        // a repeated query is answered from the result cache as long as neither the idf
+        // values nor the documents changed since it was ranked. The generations are read
+        // before anything else, so a change racing with this query makes its entry stale.
+        auto &result_cache = CacheManager::queryResultCache();
+        string key = result_cache_key(tokens, top_k);
+        uint64_t idf_generation = idf_table_->generation();
+        uint64_t corpus_generation = CacheManager::corpusGeneration();
+
+        auto cached = result_cache.get(key);
+        future<vector<Document>> early_texts; // not valid unless rank started it
+        if (cached && cached->idf_generation == idf_generation && cached->corpus_generation == corpus_generation)
         {
-            double tf_idf = rec.word_frequency * idf_map[rec.word];
-            doc_scores[rec.doc_id] += tf_idf;
+            results = cached->results;
         }
-
-        // Normalize by total number of query words
-        for (auto &[doc_id, total_score] : doc_scores)
+        else
         {
-            total_score /= tokens.size();
+            // a stale ranking mostly names the same documents as the new one will
+            vector<string> likely;
+            if (cached)
+            {
+                for (const auto &result : cached->results)
+                    likely.push_back(result.doc_id);
+            }
+
+            auto ranked = rank(tokens, top_k, likely, early_texts);
+            // a failed postings lookup must not leave an empty or partial ranking behind
+            // for every repeat of the query
+            if (!ranked)
+                return results;
+
+            auto &dictionary = DocIdDictionary::instance();
+            // UUIDs are only materialized for the top_k
+            for (const auto &scored : *ranked)
+            {
+                results.push_back({dictionary.doc_id(scored.doc), scored.score, ""});
+            }
+            // cached unnormalized: "cat dog" and "cat cat dog" share the entry
+            result_cache.put(key, QueryResult{idf_generation, corpus_generation, results});
         }
 
-        // Sort and get top_k - to -do : Understand this logic
-        vector<pair<string, double>> sorted_docs(doc_scores.begin(), doc_scores.end());
-        sort(sorted_docs.begin(), sorted_docs.end(), [](auto &a, auto &b)
-             { return a.second > b.second; });
-        if (sorted_docs.size() > top_k)
-            sorted_docs.resize(top_k);
+        // Normalize by total number of query words
+        for (auto &result : results)
+            result.score /= query_words;
 
         auto &doc_cache = CacheManager::documentCache();
 
-        // Fetch document text for top_k only
-        for (auto &[doc_id, avg_score] : sorted_docs)
+        // Fetch document text for top_k only, every cache miss in one query
+        vector<string> missing;
+        for (auto &result : results)
         {
-            string text;
             // check if it exists in cache
-            auto cached_doc = doc_cache.get(doc_id);
-            if (cached_doc.has_value())
+            auto cached_doc = doc_cache.get(result.doc_id);
+            if (cached_doc)
             {
-                text = cached_doc.value();
-                cout << "While searching " << doc_id << " found in cache" << endl;
+                result.text = *cached_doc;
+                LOG_DEBUG("While searching " << result.doc_id << " found in cache");
             }
             else
             {
-                auto doc_opt = doc_repo_->get_document_by_id(doc_id);
-                if (doc_opt.has_value())
-                {
-                    text = doc_opt->document_text;
-                    doc_cache.put(doc_id, text);
-                }
-                cout << "While searching " << doc_id << " was put into cache" << endl;
+                missing.push_back(result.doc_id);
+            }
+        }
+
+        if (!missing.empty())
+        {
+            // texts read alongside the postings, only the rest is read now
+            unordered_map<string, string> texts;
+            if (early_texts.valid())
+            {
+                for (auto &doc : early_texts.get())
+                    texts.emplace(move(doc.doc_id), move(doc.document_text));
+            }
+
+            vector<string> unread;
+            for (const auto &doc_id : missing)
+            {
+                if (!texts.count(doc_id))
+                    unread.push_back(doc_id);
+            }
+            for (auto &doc : doc_repo_->get_documents_by_ids(unread))
+                texts.emplace(move(doc.doc_id), move(doc.document_text));
+
+            for (const auto &doc_id : missing)
+            {
+                auto it = texts.find(doc_id);
+                if (it != texts.end())
+                    doc_cache.put(doc_id, it->second);
+            }
+
+            for (auto &result : results)
+            {
+                auto it = texts.find(result.doc_id);
+                if (it != texts.end())
+                    result.text = it->second;
             }
-            results.push_back({doc_id, avg_score, text});
+            LOG_DEBUG("While searching " << missing.size() << " documents were put into cache");
         }
     }
     catch (const exception &ex)
     {
-        cerr << "Exception occured while searching document in search service: " << ex.what() << endl;
+        LOG_ERROR("Exception occured while searching document in search service: " << ex.what());
     }
     catch (...)
     {
-        cerr << "Exception occured while searching document in search service" << endl;
+        LOG_ERROR("Exception occured while searching document in search service");
     }
     return results;
 }
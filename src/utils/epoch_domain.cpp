@@ -0,0 +1,101 @@
+#include "utils/epoch_domain.h"
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+    // process wide thread numbers, reused after a thread exits so slots never run out
+    // for a pool of long lived workers plus the odd short lived thread
+    pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+    vector<size_t> free_indices;
+    size_t next_index = 0;
+
+    struct ThreadIndex
+    {
+        size_t value;
+
+        ThreadIndex()
+        {
+            pthread_mutex_lock(&registry_lock);
+            if (!free_indices.empty())
+            {
+                value = free_indices.back();
+                free_indices.pop_back();
+            }
+            else
+            {
+                value = next_index++;
+            }
+            pthread_mutex_unlock(&registry_lock);
+        }
+
+        ~ThreadIndex()
+        {
+            pthread_mutex_lock(&registry_lock);
+            free_indices.push_back(value);
+            pthread_mutex_unlock(&registry_lock);
+        }
+    };
+
+    thread_local ThreadIndex thread_index;
+}
+
+EpochDomain::Guard::Guard(EpochDomain &domain)
+{
+    size_t index = thread_index.value;
+    if (index >= MAX_READERS)
+        throw runtime_error("EpochDomain: too many reader threads");
+
+    slot_ = &domain.readers_[index];
+    outer_ = slot_->epoch.load(memory_order_relaxed) == 0;
+    // seq_cst store: either the writer's scan sees this pin, or this reader sees the
+    // writer's pointer swap that preceded the scan
+    if (outer_)
+        slot_->epoch.store(domain.epoch_.load(memory_order_seq_cst), memory_order_seq_cst);
+}
+
+EpochDomain::EpochDomain()
+    : readers_(new ReaderSlot[MAX_READERS])
+{
+    pthread_mutex_init(&retire_lock_, nullptr);
+}
+
+EpochDomain::~EpochDomain()
+{
+    // no reader may be left at destruction
+    for (auto &retired : retired_)
+        retired.free();
+    pthread_mutex_destroy(&retire_lock_);
+}
+
+void EpochDomain::retire(function<void()> free)
+{
+    pthread_mutex_lock(&retire_lock_);
+    // readers pinned from now on get a later epoch and cannot have seen the old version
+    retired_.push_back({epoch_.fetch_add(1, memory_order_seq_cst), move(free)});
+    collect();
+    pthread_mutex_unlock(&retire_lock_);
+}
+
+void EpochDomain::collect()
+{
+    uint64_t oldest = epoch_.load(memory_order_seq_cst);
+    for (size_t i = 0; i < MAX_READERS; i++)
+    {
+        uint64_t pinned = readers_[i].epoch.load(memory_order_seq_cst);
+        if (pinned != 0 && pinned < oldest)
+            oldest = pinned;
+    }
+
+    // a version retired at epoch e may be held by readers pinned at e or earlier
+    vector<Retired> kept;
+    for (auto &retired : retired_)
+    {
+        if (retired.epoch < oldest)
+            retired.free();
+        else
+            kept.push_back(move(retired));
+    }
+    retired_.swap(kept);
+}
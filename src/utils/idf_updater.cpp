@@ -1,11 +1,12 @@
 #include "utils/idf_updater.h"
 #include "models/idf_stats.h"
-#include "db/document_repository.h"
-#include "db/term_frequency_repository.h"
-#include "db_connection.h"
-#include <unistd.h> // for sleep
+#include "models/document_frequencies.h"
+#include "utils/cache_manager.h"
+#include "utils/logger.h"
+#include <algorithm>
+#include <chrono>
 #include <cmath>
-#include <iostream>
+#include <unordered_map>
 #include <dotenv.h>
 
 using namespace std;
@@ -15,60 +16,88 @@ void* idf_updater_thread(void* arg){
     try
     {
 
-        // casting argument passed into idf_table pointer
-        IDFTable *idf_table = static_cast<IDFTable *>(arg);
+        // casting argument passed into the updater arguments
+        IDFUpdaterArgs *args = static_cast<IDFUpdaterArgs *>(arg);
+        IDFTable *idf_table = args->idf_table;
         dotenv::init("../../.env");
 
-        DBConnection db_conn(dotenv::getenv("DATABASE_NAME"), dotenv::getenv("USERNAME"), dotenv::getenv("PASSWORD"));
+        // document frequencies are kept current by the write path (see DocumentFrequencies),
+        // a refresh only turns them into idf values and needs no db access
+        DocumentFrequencies &frequencies = DocumentFrequencies::instance();
+        LOG_INFO("Thread has been initialized");
 
-        // initialize document repository and term_frequency repository
-        DocumentRepository doc_repo_(&db_conn);
-        TermFrequencyRepository term_freq_repo_(&db_conn);
+        // a burst of writes is folded into one refresh once it pauses for IDF_DEBOUNCE_MS,
+        // but idf values never lag the writes by more than IDF_MAX_STALENESS_MS
+        long debounce_ms = stol(dotenv::getenv("IDF_DEBOUNCE_MS", "200"));
+        long max_staleness_ms = stol(dotenv::getenv("IDF_MAX_STALENESS_MS", "2000"));
 
-        if (!db_conn.is_connected())
-        {
-            cerr << "Failed to connect to DB in thread\n";
-            return nullptr;
-        }
-        cout << "Thread has been initialized" << endl;
+        // a rebuild requantizes every posting, so it runs at most once per
+        // IMPACT_REBUILD_INTERVAL_MS however often the idf values are refreshed
+        long rebuild_interval_ms = stol(dotenv::getenv("IMPACT_REBUILD_INTERVAL_MS", "5000"));
+        bool impacts_stale = false;
+        auto last_rebuild = chrono::steady_clock::now() - chrono::milliseconds(rebuild_interval_ms);
 
+        vector<IDFStats> idf_stats;
+        int total_documents = 0;
         while (true)
         {
-            cout << "Running cron job i.e. updating the IDF stats!" << endl;
-
-            // query the term_frequency table
-            // vector containing all the words
-            vector<IDFStats> idf_stats = term_freq_repo_.get_all_idf_stats();
-
-            cout << "Count of words in my system is: " << idf_stats.size() << endl;
-            // query the documents table
-            int total_documents = doc_repo_.get_total_documents();
-            cout << "total number of documents are:" << total_documents << endl;
+            // sleeps until a write changed the document frequencies, idle costs nothing
+            // unless a skipped rebuild is waiting for its turn
+            long idle_timeout_ms = -1;
+            if (impacts_stale)
+            {
+                auto due = last_rebuild + chrono::milliseconds(rebuild_interval_ms);
+                idle_timeout_ms = max<long>(0, chrono::duration_cast<chrono::milliseconds>(due - chrono::steady_clock::now()).count());
+            }
 
-            // log is not defined at 0
-            if (total_documents != 0)
+            if (frequencies.wait_for_changes(debounce_ms, max_staleness_ms, idf_stats, total_documents, idle_timeout_ms))
             {
-                // compute the IDF value for each word
-                for (int i = 0; i < idf_stats.size(); i++)
+                LOG_DEBUG("Running cron job i.e. updating the IDF stats!");
+                LOG_DEBUG("Count of words in my system is: " << idf_stats.size());
+                LOG_DEBUG("total number of documents are:" << total_documents);
+
+                // the next table is built off to the side, searches keep reading the current one
+                unordered_map<string, double> idfs;
+                // log is not defined at 0
+                if (total_documents != 0)
                 {
-                    // store it in the idf_table
-                    double idf = log(static_cast<double>(total_documents) / (idf_stats[i].document_count + 1)); // adding one to normalize the result
-                    idf_table->set_idf(idf_stats[i].word, idf);
+                    idfs.reserve(idf_stats.size());
+                    // compute the IDF value for each word
+                    for (int i = 0; i < idf_stats.size(); i++)
+                    {
+                        double idf = log(static_cast<double>(total_documents) / (idf_stats[i].document_count + 1)); // adding one to normalize the result
+                        idfs[idf_stats[i].word] = idf;
+                    }
                 }
+
+                // one pointer swap, words that no longer occur are dropped with the old table
+                idf_table->publish(move(idfs));
+
+                // impacts are tf x idf, so they have to follow every idf change
+                impacts_stale = args->impacts && args->index;
+
+                CacheManager::logStats();
+            }
+
+            if (impacts_stale && chrono::steady_clock::now() >= last_rebuild + chrono::milliseconds(rebuild_interval_ms))
+            {
+                last_rebuild = chrono::steady_clock::now();
+                args->impacts->rebuild(*args->index, *idf_table);
+                impacts_stale = false;
+                // documents written since the last rebuild just became rankable
+                CacheManager::corpusChanged();
             }
 
-            cout << "IDF stats computed, will sleep now..!" << endl;
-            sleep(stoi(dotenv::getenv("SLEEP_TIME")));
-            // sleep
+            LOG_DEBUG("IDF stats computed, waiting for the next change..!");
         }
     }
     catch (const exception &e)
     {
-        cerr << "Exception in IDF updater thread: " << e.what() << endl;
+        LOG_ERROR("Exception in IDF updater thread: " << e.what());
     }
     catch (...)
     {
-        cerr << "Unknown error occurred in IDF updater thread." << endl;
+        LOG_ERROR("Unknown error occurred in IDF updater thread.");
     }
 
     return nullptr;
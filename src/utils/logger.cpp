@@ -0,0 +1,290 @@
+#include "utils/logger.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+using namespace std;
+
+atomic<int> Logger::runtime_level_{static_cast<int>(LogLevel::Info)};
+
+namespace
+{
+    const char *level_name(LogLevel level)
+    {
+        switch (level)
+        {
+        case LogLevel::Debug:
+            return "DEBUG";
+        case LogLevel::Info:
+            return "INFO";
+        case LogLevel::Warn:
+            return "WARN";
+        default:
+            return "ERROR";
+        }
+    }
+
+    // appends "2026-01-31 12:00:00.123", the date and time part is only formatted again
+    // when the second changes (localtime_r is the costliest step of writing a line)
+    void append_time(string &out, const timespec &time, time_t &cached_second, string &cached_prefix)
+    {
+        if (cached_prefix.empty() || time.tv_sec != cached_second)
+        {
+            tm local;
+            localtime_r(&time.tv_sec, &local);
+            char stamp[32];
+            size_t n = strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+            cached_prefix.assign(stamp, n);
+            cached_second = time.tv_sec;
+        }
+        long millis = time.tv_nsec / 1000000;
+        out += cached_prefix;
+        out += '.';
+        out += static_cast<char>('0' + millis / 100);
+        out += static_cast<char>('0' + millis / 10 % 10);
+        out += static_cast<char>('0' + millis % 10);
+    }
+}
+
+Logger &Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+{
+    pthread_mutex_init(&lock_, nullptr);
+    pthread_mutex_init(&flush_lock_, nullptr);
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wake_, &attr);
+    pthread_condattr_destroy(&attr);
+
+    flusher_started_ = pthread_create(&flusher_, nullptr, flusher_thread, this) == 0;
+    if (!flusher_started_)
+        fprintf(stderr, "Unable to start log flusher thread, logging synchronously\n");
+}
+
+Logger::~Logger()
+{
+    pthread_mutex_lock(&lock_);
+    stopping_ = true;
+    pthread_cond_signal(&wake_);
+    pthread_mutex_unlock(&lock_);
+    if (flusher_started_)
+        pthread_join(flusher_, nullptr);
+
+    // whatever was logged up to exit
+    drain();
+
+    pthread_cond_destroy(&wake_);
+    pthread_mutex_destroy(&flush_lock_);
+    pthread_mutex_destroy(&lock_);
+}
+
+Logger::ThreadRing::~ThreadRing()
+{
+    if (ring)
+        ring->orphaned.store(true, memory_order_release);
+}
+
+Logger::Ring &Logger::thread_ring()
+{
+    static thread_local ThreadRing local;
+    if (!local.ring)
+    {
+        auto ring = make_shared<Ring>();
+        pthread_mutex_lock(&lock_);
+        ring->thread_number = next_thread_number_++;
+        rings_.push_back(ring);
+        pthread_mutex_unlock(&lock_);
+        local.ring = move(ring);
+    }
+    return *local.ring;
+}
+
+void Logger::set_level(LogLevel level)
+{
+    runtime_level_.store(static_cast<int>(level), memory_order_relaxed);
+}
+
+LogLevel Logger::parse_level(const string &name, LogLevel fallback)
+{
+    string lower;
+    for (char c : name)
+        lower += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+
+    if (lower == "debug")
+        return LogLevel::Debug;
+    if (lower == "info")
+        return LogLevel::Info;
+    if (lower == "warn" || lower == "warning")
+        return LogLevel::Warn;
+    if (lower == "error")
+        return LogLevel::Error;
+    if (lower == "off")
+        return LogLevel::Off;
+    return fallback;
+}
+
+ostringstream &Logger::line_stream()
+{
+    static thread_local ostringstream stream;
+    stream.str(string());
+    stream.clear();
+    stream.flags(ios_base::skipws | ios_base::dec);
+    stream.precision(6);
+    stream.width(0);
+    stream.fill(' ');
+    return stream;
+}
+
+void Logger::write(LogLevel level, string text)
+{
+    Ring &ring = thread_ring();
+    size_t head = ring.head.load(memory_order_relaxed);
+    if (head - ring.tail.load(memory_order_acquire) >= RING_SIZE)
+    {
+        dropped_.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+
+    // libpq error messages end in a newline, the flusher adds its own
+    while (!text.empty() && text.back() == '\n')
+        text.pop_back();
+
+    Line &line = ring.lines[head % RING_SIZE];
+    clock_gettime(CLOCK_REALTIME, &line.time);
+    line.level = level;
+    line.text = move(text);
+    ring.head.store(head + 1, memory_order_release);
+
+    if (!flusher_started_)
+        flush();
+    else if (level >= LogLevel::Warn)
+        pthread_cond_signal(&wake_); // problems show up without waiting for the interval
+}
+
+void Logger::flush()
+{
+    drain();
+}
+
+void Logger::drain()
+{
+    struct Entry
+    {
+        timespec time;
+        LogLevel level;
+        int thread_number;
+        string text;
+    };
+
+    pthread_mutex_lock(&flush_lock_);
+
+    pthread_mutex_lock(&lock_);
+    vector<shared_ptr<Ring>> rings = rings_;
+    pthread_mutex_unlock(&lock_);
+
+    vector<Entry> entries;
+    for (auto &ring : rings)
+    {
+        size_t tail = ring->tail.load(memory_order_relaxed);
+        size_t head = ring->head.load(memory_order_acquire);
+        for (; tail != head; ++tail)
+        {
+            Line &line = ring->lines[tail % RING_SIZE];
+            entries.push_back({line.time, line.level, ring->thread_number, move(line.text)});
+            line.text = string();
+        }
+        ring->tail.store(tail, memory_order_release);
+    }
+
+    // rings of exited threads are done once drained, nothing writes to them any more
+    pthread_mutex_lock(&lock_);
+    rings_.erase(remove_if(rings_.begin(), rings_.end(),
+                           [](const shared_ptr<Ring> &ring)
+                           {
+                               return ring->orphaned.load(memory_order_acquire) &&
+                                      ring->tail.load(memory_order_relaxed) == ring->head.load(memory_order_acquire);
+                           }),
+                 rings_.end());
+    pthread_mutex_unlock(&lock_);
+
+    // each ring is in order already, merge them by time
+    stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b)
+                { return a.time.tv_sec != b.time.tv_sec ? a.time.tv_sec < b.time.tv_sec : a.time.tv_nsec < b.time.tv_nsec; });
+
+    // timestamp, level and thread number take under 40 characters
+    size_t size = 0;
+    for (const auto &entry : entries)
+        size += entry.text.size() + 40;
+
+    string out, err;
+    out.reserve(size);
+    time_t cached_second = 0;
+    string cached_prefix;
+    for (const auto &entry : entries)
+    {
+        string &stream = entry.level >= LogLevel::Warn ? err : out;
+        append_time(stream, entry.time, cached_second, cached_prefix);
+        stream += ' ';
+        stream += level_name(entry.level);
+        stream += " [";
+        stream += to_string(entry.thread_number);
+        stream += "] ";
+        stream += entry.text;
+        stream += '\n';
+    }
+
+    uint64_t dropped = dropped_.load(memory_order_relaxed);
+    if (dropped != reported_dropped_)
+    {
+        timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        append_time(err, now, cached_second, cached_prefix);
+        err += " WARN [logger] " + to_string(dropped - reported_dropped_) + " lines dropped, log ring buffers full\n";
+        reported_dropped_ = dropped;
+    }
+
+    if (!out.empty())
+    {
+        fwrite(out.data(), 1, out.size(), stdout);
+        fflush(stdout);
+    }
+    if (!err.empty())
+    {
+        fwrite(err.data(), 1, err.size(), stderr);
+        fflush(stderr);
+    }
+
+    pthread_mutex_unlock(&flush_lock_);
+}
+
+void *Logger::flusher_thread(void *arg)
+{
+    Logger *logger = static_cast<Logger *>(arg);
+
+    pthread_mutex_lock(&logger->lock_);
+    while (!logger->stopping_)
+    {
+        timespec next;
+        clock_gettime(CLOCK_MONOTONIC, &next);
+        next.tv_nsec += FLUSH_INTERVAL_MS * 1000000;
+        if (next.tv_nsec >= 1000000000)
+        {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&logger->wake_, &logger->lock_, &next);
+
+        pthread_mutex_unlock(&logger->lock_);
+        logger->drain();
+        pthread_mutex_lock(&logger->lock_);
+    }
+    pthread_mutex_unlock(&logger->lock_);
+    return nullptr;
+}
@@ -1,9 +1,9 @@
 #include "utils/tokenizer.h"
+#include "utils/logger.h"
 #include <sstream>
 #include <unordered_map>
 #include <algorithm>  // for the transform function
 #include <cctype> // for ::tolower and ::ispunct
-#include <iostream>
 #include <unordered_set>
 
 using namespace std;
@@ -41,7 +41,7 @@ vector<string> Tokenizer::tokenize(const string &text)
     }
     catch (const exception &e)
     {
-        cerr << "Error while tokenzing input: " << e.what() << endl;
+        LOG_ERROR("Error while tokenzing input: " << e.what());
     }
 }
 
@@ -72,6 +72,6 @@ vector<TermFrequency> Tokenizer::tokenize_and_compute(const string &doc_id, cons
     }
     catch (const exception &e)
     {
-        cerr << "Error while performing tokenize and compute function: " << e.what() << endl;
+        LOG_ERROR("Error while performing tokenize and compute function: " << e.what());
     }
 }
@@ -0,0 +1,59 @@
+// A search whose postings lookup fails must not leave its (empty) ranking in the query
+// result cache. The pool points at a database that cannot be reached, so every lookup
+// fails: no connection, no cached entry, and a repeat of the query misses again.
+// Needs nothing listening as this user/database on 127.0.0.1:5432 (a refused or rejected
+// connection both count as a failed lookup).
+
+#include <cstdlib>
+#include <iostream>
+#include "db/connection_pool.h"
+#include "db/connection_handle.h"
+#include "db/document_repository.h"
+#include "db/term_frequency_repository.h"
+#include "models/idf_table.h"
+#include "service/search_service.h"
+#include "utils/cache_manager.h"
+#include "utils/logger.h"
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        cerr << "FAILED: " << what << endl;
+        failures++;
+    }
+}
+
+int main()
+{
+    setenv("TERM_FREQUENCY_CACHE_SIZE", "100", 1);
+    setenv("DOCUMENT_CACHE_SIZE", "100", 1);
+    setenv("QUERY_RESULT_CACHE_SIZE", "100", 1);
+    Logger::set_level(LogLevel::Off);
+
+    // no minimum, so construction does not need the database; acquires give up after 100 ms
+    ConnectionPool pool(0, 1, "lexical_retriever_unreachable", "nobody", "wrong", 100, 60000, 60000);
+    ConnectionHandle handle(&pool);
+    DocumentRepository doc_repo(&handle);
+    TermFrequencyRepository tf_repo(&handle);
+    IDFTable idf_table;
+    SearchService search_service(&doc_repo, &tf_repo, &idf_table);
+
+    auto &result_cache = CacheManager::queryResultCache();
+
+    check(search_service.search("cat dog", 3).empty(), "a failed lookup returns no results");
+    check(result_cache.size() == 0, "a failed lookup is not cached");
+
+    search_service.search("cat dog", 3);
+    check(result_cache.hits() == 0, "the repeated query is not answered from the cache");
+    check(result_cache.size() == 0, "the repeated failed lookup is not cached either");
+
+    Logger::instance().flush();
+    if (failures == 0)
+        cout << "search_result_cache_test passed" << endl;
+    return failures == 0 ? 0 : 1;
+}